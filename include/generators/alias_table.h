@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstdint>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+namespace gen {
+
+  namespace detail {
+
+    // Vose's alias method. Slot i keeps outcome i with probability
+    // threshold[i] / 2^32 and yields alias[i] otherwise, so a sample
+    // costs one 64-bit draw: the high half picks the slot by
+    // multiply-shift and the low half is the coin. The tables are
+    // written into caller storage so that many small distributions can
+    // live in the same flat arrays.
+    template <class Weight>
+    void build_alias(const Weight * weights, uint32_t n,
+                     uint32_t * threshold, uint32_t * alias)
+    {
+      const double total = std::accumulate(weights, weights + n, 0.0);
+      if (n == 0 || !(total > 0))
+        throw std::invalid_argument("alias table: weights must have a positive sum");
+
+      std::vector<double> scaled(n);
+      std::vector<uint32_t> small, large;
+      for (uint32_t i = 0; i < n; ++i)
+      {
+        if (weights[i] < 0)
+          throw std::invalid_argument("alias table: negative weight");
+        scaled[i] = weights[i] * n / total;
+        (scaled[i] < 1.0 ? small : large).push_back(i);
+      }
+
+      auto to_threshold = [](double p) {
+        const double scaled = p * 4294967296.0;
+        return scaled >= 4294967295.0 ? 0xffffffffu : static_cast<uint32_t>(scaled);
+      };
+
+      while (!small.empty() && !large.empty())
+      {
+        const uint32_t s = small.back();
+        const uint32_t l = large.back();
+        small.pop_back();
+        threshold[s] = to_threshold(scaled[s]);
+        alias[s] = l;
+        scaled[l] -= 1.0 - scaled[s];
+        if (scaled[l] < 1.0)
+        {
+          large.pop_back();
+          small.push_back(l);
+        }
+      }
+      // Leftovers are 1 up to rounding; they alias to themselves.
+      for (uint32_t i : large)
+      {
+        threshold[i] = 0xffffffffu;
+        alias[i] = i;
+      }
+      for (uint32_t i : small)
+      {
+        threshold[i] = 0xffffffffu;
+        alias[i] = i;
+      }
+    }
+
+    inline uint32_t alias_sample(const uint32_t * threshold, const uint32_t * alias,
+                                 uint32_t n, uint64_t bits)
+    {
+      const uint32_t slot = static_cast<uint32_t>(((bits >> 32) * n) >> 32);
+      return static_cast<uint32_t>(bits) < threshold[slot] ? slot : alias[slot];
+    }
+
+    // A single alias table owning its storage.
+    class alias_table
+    {
+      std::vector<uint32_t> threshold_;
+      std::vector<uint32_t> alias_;
+
+    public:
+
+      alias_table() = default;
+
+      template <class Weight>
+      explicit alias_table(const std::vector<Weight> & weights)
+        : threshold_(weights.size()),
+          alias_(weights.size())
+      {
+        build_alias(weights.data(), static_cast<uint32_t>(weights.size()),
+                    threshold_.data(), alias_.data());
+      }
+
+      uint32_t size() const
+      {
+        return static_cast<uint32_t>(threshold_.size());
+      }
+
+      uint32_t operator()(uint64_t bits) const
+      {
+        return alias_sample(threshold_.data(), alias_.data(), size(), bits);
+      }
+
+      template <class Writer>
+      void save(Writer & writer) const
+      {
+        writer.put(threshold_);
+        writer.put(alias_);
+      }
+
+      template <class Reader>
+      void load(Reader & reader)
+      {
+        reader.get(threshold_);
+        reader.get(alias_);
+        if (threshold_.size() != alias_.size())
+          throw std::runtime_error("alias table: inconsistent sizes");
+        for (uint32_t a : alias_)
+          if (a >= alias_.size())
+            throw std::runtime_error("alias table: alias index out of range");
+      }
+    };
+
+  } // namespace detail
+
+} // namespace gen
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace gen {
+
+  // Bump allocator for generated objects. Allocation is a pointer bump
+  // in a monotonic_buffer_resource; release() frees everything at once.
+  // Objects with non-trivial destructors are threaded onto an intrusive
+  // list kept in the arena itself, so they are destroyed on release
+  // while trivially destructible ones cost nothing to free.
+  class arena
+  {
+    struct cleanup
+    {
+      void * object;
+      void (*destroy)(void *);
+      cleanup * next;
+    };
+
+    std::pmr::monotonic_buffer_resource resource_;
+    cleanup * cleanups_;
+
+  public:
+
+    explicit arena(size_t initial_size = 4096,
+                   std::pmr::memory_resource * upstream = std::pmr::get_default_resource())
+      : resource_(initial_size, upstream),
+        cleanups_(nullptr)
+    { }
+
+    arena(const arena &) = delete;
+    arena & operator = (const arena &) = delete;
+
+    ~arena()
+    {
+      release();
+    }
+
+    std::pmr::memory_resource * resource()
+    {
+      return &resource_;
+    }
+
+    template <class T, class... Args>
+    T * make(Args&&... args)
+    {
+      void * mem = resource_.allocate(sizeof(T), alignof(T));
+      T * object = ::new (mem) T(std::forward<Args>(args)...);
+      if constexpr (!std::is_trivially_destructible<T>::value)
+      {
+        void * node = resource_.allocate(sizeof(cleanup), alignof(cleanup));
+        cleanups_ = ::new (node) cleanup {
+          object, [](void * p) { static_cast<T *>(p)->~T(); }, cleanups_
+        };
+      }
+      return object;
+    }
+
+    // Destroys the objects in reverse order of creation and returns
+    // the memory to the upstream resource.
+    void release()
+    {
+      for (cleanup * c = cleanups_; c; c = c->next)
+        c->destroy(c->object);
+      cleanups_ = nullptr;
+      resource_.release();
+    }
+  };
+
+  namespace detail {
+
+    arena *& active_arena()
+    {
+      thread_local arena * current = nullptr;
+      return current;
+    }
+
+  } // namespace detail
+
+  // While alive, GenFactory<T *> and GenFactory<std::shared_ptr<T>>
+  // on the calling thread allocate from the given arena instead of the
+  // heap. Raw pointers then need no delete and shared_ptrs use
+  // allocate_shared with the arena's allocator; all of them must be
+  // gone before the arena is released. Scopes nest.
+  class arena_scope
+  {
+    arena * previous_;
+
+  public:
+
+    explicit arena_scope(arena & a)
+      : previous_(detail::active_arena())
+    {
+      detail::active_arena() = &a;
+    }
+
+    arena_scope(const arena_scope &) = delete;
+    arena_scope & operator = (const arena_scope &) = delete;
+
+    ~arena_scope()
+    {
+      detail::active_arena() = previous_;
+    }
+  };
+
+} // namespace gen
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "generator.h"
+
+// Seeded value generators usable in constant expressions. Each one
+// carries its own random engine instead of drawing from the per-thread
+// engine, so
+//
+//   constexpr auto seeds = gen::cx::to_array<64>(
+//                            gen::cx::make_range_gen(0u, 1u << 31, 0xAC0));
+//
+// is computed by the compiler and embedded in the binary. They compose
+// with the constexpr-capable parts of generator.h: map, take,
+// make_stepper_gen and make_array_gen.
+
+namespace gen {
+
+  namespace cx {
+
+    namespace detail {
+
+      template <class Integer>
+      class RangeGen
+      {
+        Integer lo_, hi_;
+        gen::detail::Engine engine_;
+
+      public:
+
+        // [lo, hi) must not be empty; in a constant expression the
+        // throw becomes a compile error naming the reason.
+        constexpr RangeGen(Integer lo, Integer hi, uint64_t seed)
+          : lo_(lo),
+            hi_(hi),
+            engine_(seed)
+        {
+          if (!(lo < hi))
+            throw std::invalid_argument("cx::make_range_gen: empty range [lo, hi)");
+        }
+
+        constexpr Integer operator()()
+        {
+          const uint64_t span = static_cast<uint64_t>(hi_) - static_cast<uint64_t>(lo_);
+          return static_cast<Integer>(static_cast<uint64_t>(lo_) + engine_.next() % span);
+        }
+      };
+
+      template <class T, size_t N>
+      class OneofGen
+      {
+        static_assert(N > 0, "cx::make_oneof_gen: no options to choose from");
+
+        std::array<T, N> options_;
+        gen::detail::Engine engine_;
+
+      public:
+
+        constexpr OneofGen(const std::array<T, N> & options, uint64_t seed)
+          : options_(options),
+            engine_(seed)
+        { }
+
+        constexpr T operator()()
+        {
+          return options_[engine_.next() % N];
+        }
+      };
+
+    } // namespace detail
+
+    template <class Integer>
+    constexpr auto make_range_gen(Integer lo, Integer hi, uint64_t seed)
+    {
+      return make_gen_from(detail::RangeGen<Integer>(lo, hi, seed));
+    }
+
+    template <class T, size_t N>
+    constexpr auto make_oneof_gen(const std::array<T, N> & options, uint64_t seed)
+    {
+      return make_gen_from(detail::OneofGen<T, N>(options, seed));
+    }
+
+    // The next N values of gen.
+    template <size_t N, class Gen>
+    constexpr auto to_array(Gen gen)
+    {
+      std::array<typename Gen::value_type, N> arr {};
+      for (auto & elem : arr)
+        elem = gen.generate();
+
+      return arr;
+    }
+
+  } // namespace cx
+
+} // namespace gen
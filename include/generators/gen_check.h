@@ -0,0 +1,146 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <mutex>
+
+#include "generator.h"
+
+namespace gen {
+
+  // Outcome of check(). When a counterexample is found, failed_case is
+  // the lowest failing case index and seed is the engine seed of that
+  // case; replay(gen, result) regenerates the counterexample, and so
+  // does replay(gen, seed) for generators without a position.
+  template <class T>
+  struct check_result
+  {
+    bool passed;
+    size_t cases;
+    size_t failed_case;
+    uint64_t seed;
+    uint64_t base_seed;
+    boost::optional<T> counterexample;
+  };
+
+  // Reseeds the engine of the calling thread and generates one value
+  // from a copy of gen.
+  template <class Gen>
+  auto replay(const Gen & gen, uint64_t seed)
+  {
+    Gen local(gen);
+    detail::engine().reseed(seed);
+    return local.generate();
+  }
+
+  // Regenerates the failed case of result from a copy of gen. A
+  // generator with a position (stepper, take, inorder, ...) is first
+  // advanced past the earlier cases, each under its own seed.
+  template <class Gen>
+  auto replay(const Gen & gen, const check_result<typename Gen::value_type> & result)
+  {
+    Gen local(gen);
+    if constexpr (Gen::has_position)
+      for (size_t i = 0; i < result.failed_case; ++i)
+      {
+        detail::engine().reseed(detail::stream_seed(result.base_seed, i));
+        local.skip(1);
+      }
+    detail::engine().reseed(result.seed);
+    return local.generate();
+  }
+
+  // Runs predicate on n generated cases spread over threads workers
+  // (0 means one per hardware thread). Case i draws from its own engine
+  // sub-stream, so the outcome does not depend on the number of
+  // threads as long as gen's values are driven by the random engine
+  // (the usual case for property-based testing). Workers stop as soon
+  // as every case below the lowest known counterexample has been
+  // checked. A predicate that throws fails its case. A finite gen
+  // that ends (out_of_range) ends the run at that case instead; cases
+  // then reports how many were checked. Every worker copies gen, so it
+  // must not contain borrow() or share() wrappers. A generator with a
+  // position yields case i only after the i cases before it, so it is
+  // checked on the calling thread alone.
+  template <class Gen, class Predicate>
+  auto check(const Gen & gen, Predicate&& predicate, size_t n,
+             unsigned threads = 0, uint64_t base_seed = 0)
+  {
+    typedef typename Gen::value_type T;
+    constexpr size_t CHUNK = 1024;
+    static_assert(!detail::shares_state<Gen>::value,
+                  "check copies the generator per thread; "
+                  "borrowed and shared generators are single-threaded");
+
+    if (base_seed == 0)
+      base_seed = random_uint64();
+    if constexpr (Gen::has_position)
+      threads = 1;
+
+    std::atomic<size_t> next(0);
+    std::atomic<size_t> failed(std::numeric_limits<size_t>::max());
+    std::atomic<size_t> end(n);
+    std::mutex mutex;
+    check_result<T> result { true, n, std::numeric_limits<size_t>::max(), 0, base_seed,
+                             boost::none };
+
+    detail::parallel_for(threads, [&](unsigned) {
+      Gen local(gen);
+      while (true)
+      {
+        size_t begin = next.fetch_add(CHUNK);
+        if (begin >= end.load() || begin >= failed.load())
+          return;
+
+        size_t last = std::min(n, begin + CHUNK);
+        for (size_t i = begin; i < last && i < end.load() && i < failed.load(); ++i)
+        {
+          uint64_t seed = detail::stream_seed(base_seed, i);
+          detail::engine().reseed(seed);
+          boost::optional<T> value;
+          try {
+            value.emplace(local.generate());
+          }
+          catch (std::out_of_range &) {
+            size_t current = end.load();
+            while (i < current && !end.compare_exchange_weak(current, i))
+              ;
+            return;
+          }
+          catch (std::exception &) {
+          }
+
+          bool ok = false;
+          if (value)
+          {
+            try {
+              ok = predicate(*value);
+            }
+            catch (std::exception &) {
+              ok = false;
+            }
+          }
+
+          if (!ok)
+          {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (i < result.failed_case)
+            {
+              result.passed = false;
+              result.cases = i + 1;
+              result.failed_case = i;
+              result.seed = seed;
+              result.counterexample = std::move(value);
+              failed.store(i);
+            }
+            return;
+          }
+        }
+      }
+    });
+
+    result.cases = std::min(result.cases, end.load());
+    return result;
+  }
+
+} // namespace gen
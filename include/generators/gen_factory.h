@@ -6,7 +6,7 @@ namespace gen {
   auto GenFactory<bool>::make()
   {
     return make_gen_from([]() {
-      return (random_int32() % 2)? true : false;
+      return random_below(2) != 0;
     });
   }
 
@@ -20,7 +20,7 @@ namespace gen {
   auto GenFactory<int8_t>::make()
   {
     return make_gen_from([]() {
-      return static_cast<int8_t>(random_int32() % std::numeric_limits<int8_t>::max());
+      return static_cast<int8_t>(random_below(std::numeric_limits<int8_t>::max()));
     });
   }
 
@@ -28,7 +28,7 @@ namespace gen {
   auto GenFactory<int16_t>::make()
   {
     return make_gen_from([]() {
-      return static_cast<int16_t>(random_int32() % std::numeric_limits<int16_t>::max());
+      return static_cast<int16_t>(random_below(std::numeric_limits<int16_t>::max()));
     });
   }
 
@@ -52,7 +52,7 @@ namespace gen {
   auto GenFactory<uint8_t>::make()
   {
     return make_gen_from([]() {
-      return static_cast<uint8_t>(random_int32() % std::numeric_limits<uint8_t>::max());
+      return static_cast<uint8_t>(random_below(std::numeric_limits<uint8_t>::max()));
     });
   }
 
@@ -60,7 +60,7 @@ namespace gen {
   auto GenFactory<uint16_t>::make()
   {
     return make_gen_from([]() {
-      return static_cast<uint16_t>(random_int32() % std::numeric_limits<uint16_t>::max());
+      return static_cast<uint16_t>(random_below(std::numeric_limits<uint16_t>::max()));
     });
   }
 
@@ -83,31 +83,19 @@ namespace gen {
   template <>
   auto GenFactory<float>::make()
   {
-    return make_gen_from([]() {
-      return  static_cast<float>(random_int32()) / random_int32();
-      //std::numeric_limits<int32_t>::max() *
-      //std::numeric_limits<float>::max();
-    });
+    return make_unit_gen<float>();
   }
 
   template <>
   auto GenFactory<double>::make()
   {
-    return make_gen_from([]() {
-      return  static_cast<double>((random_int32()) /
-        std::numeric_limits<int32_t>::max() *
-        std::numeric_limits<double>::max());
-    });
+    return make_unit_gen<double>();
   }
 
   template <>
   auto GenFactory<long double>::make()
   {
-    return make_gen_from([]() {
-      return  static_cast<long double>(random_int32()) /
-        std::numeric_limits<int32_t>::max() *
-        std::numeric_limits<long double>::max();
-    });
+    return make_unit_gen<long double>();
   }
 
   template <class T>
@@ -186,7 +174,10 @@ namespace gen {
     static auto make()
     {
       auto tgen = GenFactory<T>::make();
-      return make_gen_from([tgen]() mutable {
+      return make_gen_from([tgen = std::move(tgen)]() mutable {
+            if (arena * pool = detail::active_arena())
+              return std::allocate_shared<T>(std::pmr::polymorphic_allocator<T>(pool->resource()),
+                                             tgen.generate());
             return std::make_shared<T>(tgen.generate());
           });
     }
@@ -198,7 +189,9 @@ namespace gen {
     static auto make()
     {
       auto tgen = GenFactory<T>::make();
-      return make_gen_from([tgen]() mutable {
+      return make_gen_from([tgen = std::move(tgen)]() mutable {
+            if (arena * pool = detail::active_arena())
+              return pool->make<T>(tgen.generate());
             return new T(tgen.generate());
           });
     }
@@ -1,12 +1,13 @@
 #pragma once
 
+#include <cstddef>
 #include <iterator>
+#include <optional>
 
 namespace gen {
 
   template <class T, class Gen>
-  class gen_iterator :
-    public std::iterator<std::input_iterator_tag, T>
+  class gen_iterator
   {
     Gen * gen_;
     bool end_;
@@ -14,6 +15,8 @@ namespace gen {
 
   public:
 
+    typedef std::input_iterator_tag iterator_category;
+    typedef std::ptrdiff_t difference_type;
     typedef T  value_type;
     typedef const T & reference;
     typedef const T * pointer;
@@ -66,4 +69,73 @@ namespace gen {
     }
   };
 
-} // namespace gen
\ No newline at end of file
+#ifdef GEN_HAS_RANGES
+
+  // Move-only input iterator paired with std::default_sentinel_t. The
+  // iterator owns the current value and hands out a mutable reference,
+  // so large records can be moved out (std::ranges::iter_move) instead
+  // of copied, and regenerates it in place on increment. The end of a
+  // finite generator is still signalled by std::out_of_range, caught
+  // once.
+  template <class T, class Gen>
+  class gen_input_iterator
+  {
+    Gen * gen_;
+    mutable std::optional<T> current_;
+
+  public:
+
+    typedef std::input_iterator_tag iterator_concept;
+    typedef std::ptrdiff_t difference_type;
+    typedef T value_type;
+
+    gen_input_iterator()
+      : gen_(nullptr)
+    { }
+
+    explicit gen_input_iterator(Gen & gen)
+      : gen_(&gen)
+    { }
+
+    gen_input_iterator(gen_input_iterator &&) = default;
+    gen_input_iterator & operator = (gen_input_iterator &&) = default;
+
+    T & operator *() const {
+      return *current_;
+    }
+
+    T * operator ->() const {
+      return &*current_;
+    }
+
+    gen_input_iterator & operator ++ () {
+      try {
+        // a value left in the iterator (even a moved-from one) is
+        // regenerated in place to reuse its memory
+        if (current_)
+          gen_->generate_into(*current_);
+        else
+          current_.emplace(gen_->generate());
+      }
+      catch (std::out_of_range &) {
+        current_.reset();
+      }
+      return *this;
+    }
+
+    void operator ++ (int) {
+      ++(*this);
+    }
+
+    friend T && iter_move(const gen_input_iterator & iter) {
+      return std::move(*iter.current_);
+    }
+
+    bool operator == (std::default_sentinel_t) const {
+      return !current_;
+    }
+  };
+
+#endif // GEN_HAS_RANGES
+
+} // namespace gen
@@ -0,0 +1,571 @@
+#pragma once
+
+#include <charconv>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <utility>
+
+#include "generator.h"
+
+namespace gen {
+
+  // Options shared by to_csv and to_jsonl.
+  //   buffer_size : bytes formatted before a single ostream::write.
+  //   pipelined   : hand full buffers to a writer thread so that
+  //                 formatting and I/O overlap.
+  //   field_names : csv header row / jsonl object keys for the
+  //                 top-level fields of a record. Empty means no
+  //                 header and json arrays.
+  //   max_records : stop after this many records even if the
+  //                 generator is infinite.
+  struct sink_options
+  {
+    size_t buffer_size = 1 << 20;
+    bool pipelined = false;
+    char delimiter = ',';
+    std::vector<std::string> field_names;
+    size_t max_records = std::numeric_limits<size_t>::max();
+  };
+
+  namespace detail {
+
+    // Small finite sources do not need the full buffer.
+    template <class Gen>
+    size_t sink_capacity(const Gen & gen, const sink_options & opts)
+    {
+      constexpr size_t BYTES_PER_RECORD = 256;
+      const size_t records = std::min(gen.size_hint().upper, opts.max_records);
+      if (records < opts.buffer_size / BYTES_PER_RECORD)
+        return records * BYTES_PER_RECORD;
+      return opts.buffer_size;
+    }
+
+    // Double-buffered byte sink. Formatting appends into the active
+    // buffer; a full buffer is written with one ostream::write, either
+    // inline or by the writer thread while the next one is filled.
+    class sink_buffer
+    {
+      std::ostream & out_;
+      std::vector<char> active_;
+      std::vector<char> pending_;
+      size_t used_;
+      size_t pending_size_;
+      bool pipelined_;
+      bool busy_;
+      bool done_;
+      std::mutex mutex_;
+      std::condition_variable cv_;
+      std::thread writer_;
+
+      void write_loop()
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true)
+        {
+          cv_.wait(lock, [this]() { return busy_ || done_; });
+          if (busy_)
+          {
+            lock.unlock();
+            out_.write(pending_.data(), pending_size_);
+            lock.lock();
+            busy_ = false;
+            cv_.notify_all();
+          }
+          else if (done_)
+            return;
+        }
+      }
+
+      void hand_off()
+      {
+        if (!pipelined_)
+        {
+          out_.write(active_.data(), used_);
+          used_ = 0;
+          return;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return !busy_; });
+        // the writer is idle, so the buffer it gives back can grow to
+        // the size reserve() last needed
+        if (pending_.size() < active_.size())
+          pending_.resize(active_.size());
+        active_.swap(pending_);
+        pending_size_ = used_;
+        busy_ = true;
+        used_ = 0;
+        cv_.notify_all();
+      }
+
+    public:
+
+      sink_buffer(std::ostream & out, size_t capacity, bool pipelined)
+        : out_(out),
+          active_(capacity < 64 ? 64 : capacity),
+          pending_(pipelined ? active_.size() : 0),
+          used_(0),
+          pending_size_(0),
+          pipelined_(pipelined),
+          busy_(false),
+          done_(false)
+      {
+        if (pipelined_)
+          writer_ = std::thread([this]() { write_loop(); });
+      }
+
+      sink_buffer(const sink_buffer &) = delete;
+      sink_buffer & operator = (const sink_buffer &) = delete;
+
+      ~sink_buffer()
+      {
+        finish();
+      }
+
+      void finish()
+      {
+        if (used_ > 0)
+          hand_off();
+
+        if (writer_.joinable())
+        {
+          {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this]() { return !busy_; });
+            done_ = true;
+          }
+          cv_.notify_all();
+          writer_.join();
+        }
+      }
+
+      // Returns a pointer to at least n writable bytes.
+      char * reserve(size_t n)
+      {
+        if (used_ + n > active_.size())
+        {
+          hand_off();
+          // pending_ may be in the writer's hands; it catches up at
+          // the next hand_off
+          if (n > active_.size())
+            active_.resize(n);
+        }
+        return active_.data() + used_;
+      }
+
+      void put(char ch)
+      {
+        *reserve(1) = ch;
+        ++used_;
+      }
+
+      void append(const char * str, size_t len)
+      {
+        std::memcpy(reserve(len), str, len);
+        used_ += len;
+      }
+
+      template <class Number>
+      void put_number(Number num)
+      {
+        // 64 bytes covers every integer and the shortest round-trip
+        // representation of float, double and long double.
+        char * first = reserve(64);
+        auto result = std::to_chars(first, first + 64, num);
+        used_ += result.ptr - first;
+      }
+    };
+
+    template <class T>
+    struct is_optional : std::false_type {};
+
+    template <class T>
+    struct is_optional<boost::optional<T>> : std::true_type {};
+
+    template <class T>
+    struct is_tuple_like : std::false_type {};
+
+    template <class... Args>
+    struct is_tuple_like<std::tuple<Args...>> : std::true_type {};
+
+    template <class T, class U>
+    struct is_tuple_like<std::pair<T, U>> : std::true_type {};
+
+    template <class T>
+    struct is_string_like
+      : std::integral_constant<bool,
+          std::is_same<T, std::string>::value ||
+          std::is_same<T, std::string_view>::value ||
+          std::is_same<T, const char *>::value ||
+          std::is_same<T, char *>::value> {};
+
+    template <class T, class = void>
+    struct is_sequence : std::false_type {};
+
+    template <class T>
+    struct is_sequence<T,
+      std::void_t<decltype(std::declval<const T &>().begin()),
+                  decltype(std::declval<const T &>().end())>>
+      : std::integral_constant<bool, !is_string_like<T>::value> {};
+
+    // User-defined records are written through an ADL-visible
+    //   auto as_tuple(const Record &) -> std::tuple<const Field &...>
+    // which is typically implemented with std::tie.
+    template <class T, class = void>
+    struct has_as_tuple : std::false_type {};
+
+    template <class T>
+    struct has_as_tuple<T,
+      std::void_t<decltype(as_tuple(std::declval<const T &>()))>>
+      : std::true_type {};
+
+    template <class T>
+    struct is_record
+      : std::integral_constant<bool,
+          is_tuple_like<T>::value || has_as_tuple<T>::value> {};
+
+    template <class T>
+    struct is_optional_record : std::false_type {};
+
+    template <class T>
+    struct is_optional_record<boost::optional<T>> : is_record<T> {};
+
+    template <class T, class Func>
+    void for_each_field(const T & rec, Func && func)
+    {
+      if constexpr (has_as_tuple<T>::value)
+        for_each_field(as_tuple(rec), std::forward<Func>(func));
+      else
+        std::apply([&func](const auto &... fields) {
+          (func(fields), ...);
+        }, rec);
+    }
+
+    template <class Str>
+    std::pair<const char *, size_t> string_data(const Str & str)
+    {
+      if constexpr (std::is_same<Str, std::string>::value ||
+                    std::is_same<Str, std::string_view>::value)
+        return { str.data(), str.size() };
+      else
+        return { str, str ? std::strlen(str) : 0 };
+    }
+
+    class csv_writer
+    {
+      sink_buffer & buf_;
+      char delimiter_;
+      bool first_;
+
+      void separate()
+      {
+        if (!first_)
+          buf_.put(delimiter_);
+        first_ = false;
+      }
+
+      void write_string(const char * str, size_t len)
+      {
+        bool quote = false;
+        for (size_t i = 0; i < len && !quote; ++i)
+          quote = (str[i] == delimiter_) || (str[i] == '"') ||
+                  (str[i] == '\n') || (str[i] == '\r');
+
+        if (!quote)
+        {
+          buf_.append(str, len);
+          return;
+        }
+
+        buf_.put('"');
+        for (size_t i = 0; i < len; ++i)
+        {
+          if (str[i] == '"')
+            buf_.put('"');
+          buf_.put(str[i]);
+        }
+        buf_.put('"');
+      }
+
+      // Scalars and nested sequences inside one csv field.
+      template <class T>
+      void write_scalar(const T & val)
+      {
+        if constexpr (std::is_same<T, bool>::value)
+          buf_.append(val ? "true" : "false", val ? 4 : 5);
+        else if constexpr (std::is_same<T, char>::value)
+          write_string(&val, 1);
+        else if constexpr (std::is_arithmetic<T>::value)
+          buf_.put_number(val);
+        else if constexpr (is_string_like<T>::value)
+        {
+          auto str = string_data(val);
+          write_string(str.first, str.second);
+        }
+        else if constexpr (is_optional<T>::value)
+        {
+          if (val)
+            write_scalar(*val);
+        }
+        else if constexpr (is_sequence<T>::value)
+        {
+          // nested sequences are space separated within the field
+          bool first = true;
+          for (const auto & elem : val)
+          {
+            if (!first)
+              buf_.put(' ');
+            first = false;
+            write_scalar(elem);
+          }
+        }
+        else
+        {
+          if (val)
+            write_scalar(*val);
+        }
+      }
+
+    public:
+
+      csv_writer(sink_buffer & buf, char delimiter)
+        : buf_(buf),
+          delimiter_(delimiter),
+          first_(true)
+      { }
+
+      // Records (tuples, pairs, as_tuple structs) are flattened into
+      // consecutive fields; everything else occupies one field.
+      template <class T>
+      void write_field(const T & val)
+      {
+        if constexpr (is_record<T>::value)
+          for_each_field(val, [this](const auto & field) {
+            write_field(field);
+          });
+        else if constexpr (is_optional_record<T>::value)
+        {
+          if (val)
+            write_field(*val);
+          else
+            separate();
+        }
+        else
+        {
+          separate();
+          write_scalar(val);
+        }
+      }
+
+      template <class T>
+      void write_row(const T & rec)
+      {
+        first_ = true;
+        if constexpr (is_sequence<T>::value)
+        {
+          for (const auto & elem : rec)
+            write_field(elem);
+        }
+        else
+          write_field(rec);
+        buf_.put('\n');
+      }
+
+      void write_header(const std::vector<std::string> & names)
+      {
+        first_ = true;
+        for (const auto & name : names)
+        {
+          separate();
+          write_string(name.data(), name.size());
+        }
+        buf_.put('\n');
+      }
+    };
+
+    class json_writer
+    {
+      sink_buffer & buf_;
+
+      void write_string(const char * str, size_t len)
+      {
+        static const char hex[] = "0123456789abcdef";
+        buf_.put('"');
+        for (size_t i = 0; i < len; ++i)
+        {
+          unsigned char ch = static_cast<unsigned char>(str[i]);
+          if (ch == '"' || ch == '\\')
+          {
+            buf_.put('\\');
+            buf_.put(static_cast<char>(ch));
+          }
+          else if (ch < 0x20 || ch == 0x7f)
+          {
+            char esc[6] = { '\\', 'u', '0', '0', hex[ch >> 4], hex[ch & 0xf] };
+            buf_.append(esc, 6);
+          }
+          else
+            buf_.put(static_cast<char>(ch));
+        }
+        buf_.put('"');
+      }
+
+    public:
+
+      explicit json_writer(sink_buffer & buf)
+        : buf_(buf)
+      { }
+
+      template <class T>
+      void write_value(const T & val)
+      {
+        if constexpr (std::is_same<T, bool>::value)
+          buf_.append(val ? "true" : "false", val ? 4 : 5);
+        else if constexpr (std::is_same<T, char>::value)
+          write_string(&val, 1);
+        else if constexpr (std::is_floating_point<T>::value)
+        {
+          // json has no representation for nan and inf
+          if (val - val == 0)
+            buf_.put_number(val);
+          else
+            buf_.append("null", 4);
+        }
+        else if constexpr (std::is_arithmetic<T>::value)
+          buf_.put_number(val);
+        else if constexpr (is_string_like<T>::value)
+        {
+          auto str = string_data(val);
+          write_string(str.first, str.second);
+        }
+        else if constexpr (is_optional<T>::value)
+        {
+          if (val)
+            write_value(*val);
+          else
+            buf_.append("null", 4);
+        }
+        else if constexpr (is_record<T>::value)
+        {
+          bool first = true;
+          buf_.put('[');
+          for_each_field(val, [this, &first](const auto & field) {
+            if (!first)
+              buf_.put(',');
+            first = false;
+            write_value(field);
+          });
+          buf_.put(']');
+        }
+        else if constexpr (is_sequence<T>::value)
+        {
+          bool first = true;
+          buf_.put('[');
+          for (const auto & elem : val)
+          {
+            if (!first)
+              buf_.put(',');
+            first = false;
+            write_value(elem);
+          }
+          buf_.put(']');
+        }
+        else
+        {
+          if (val)
+            write_value(*val);
+          else
+            buf_.append("null", 4);
+        }
+      }
+
+      template <class T>
+      void write_line(const T & rec, const std::vector<std::string> & names)
+      {
+        if constexpr (is_record<T>::value)
+        {
+          if (!names.empty())
+          {
+            size_t i = 0;
+            buf_.put('{');
+            for_each_field(rec, [this, &i, &names](const auto & field) {
+              if (i > 0)
+                buf_.put(',');
+              if (i < names.size())
+                write_string(names[i].data(), names[i].size());
+              else
+                write_value(std::to_string(i));
+              buf_.put(':');
+              write_value(field);
+              ++i;
+            });
+            buf_.put('}');
+            buf_.put('\n');
+            return;
+          }
+        }
+        write_value(rec);
+        buf_.put('\n');
+      }
+    };
+
+  } // namespace detail
+
+  // Drains gen into out as comma separated values, one record per
+  // line. Returns the number of records written.
+  template <class Gen>
+  size_t to_csv(Gen&& gen, std::ostream & out,
+                const sink_options & opts = sink_options())
+  {
+    detail::sink_buffer buf(out, detail::sink_capacity(gen, opts), opts.pipelined);
+    detail::csv_writer writer(buf, opts.delimiter);
+    size_t count = 0;
+
+    if (!opts.field_names.empty())
+      writer.write_header(opts.field_names);
+
+    try {
+      while (count < opts.max_records)
+      {
+        writer.write_row(gen.generate());
+        ++count;
+      }
+    }
+    catch (std::out_of_range &) {
+    }
+
+    buf.finish();
+    return count;
+  }
+
+  // Drains gen into out as JSON lines, one value per line. Returns
+  // the number of records written.
+  template <class Gen>
+  size_t to_jsonl(Gen&& gen, std::ostream & out,
+                  const sink_options & opts = sink_options())
+  {
+    detail::sink_buffer buf(out, detail::sink_capacity(gen, opts), opts.pipelined);
+    detail::json_writer writer(buf);
+    size_t count = 0;
+
+    try {
+      while (count < opts.max_records)
+      {
+        writer.write_line(gen.generate(), opts.field_names);
+        ++count;
+      }
+    }
+    catch (std::out_of_range &) {
+    }
+
+    buf.finish();
+    return count;
+  }
+
+} // namespace gen
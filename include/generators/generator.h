@@ -1,19 +1,42 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <cstdlib>
+#include <iterator>
 #include <vector>
 #include <queue>
 #include <list>
+#include <algorithm>
 #include <array>
+#include <cmath>
+#include <functional>
+#include <cstdint>
+#include <cstring>
 #include <ctime>
+#include <exception>
 #include <limits>
 #include <memory>
 #include <stdexcept>
+#include <thread>
+#include <tuple>
 #include <type_traits>
+#include <utility>
+
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif // __SSSE3__
 
 #include <boost/optional.hpp>
 
+#include "alias_table.h"
+#include "arena.h"
+
+#if __cplusplus >= 202002L || (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L)
+#include <ranges>
+#define GEN_HAS_RANGES 1
+#endif // C++20
+
 namespace gen {
 
   constexpr unsigned int DEFAULT_MAX_STR_LEN = 10;
@@ -22,37 +45,235 @@ namespace gen {
   template <class T, class Gen>
   class gen_iterator;
 
-#ifdef WIN32
+#ifdef GEN_HAS_RANGES
+  template <class T, class Gen>
+  class gen_input_iterator;
+#endif // GEN_HAS_RANGES
+
+  namespace detail {
+
+    constexpr uint64_t splitmix64(uint64_t & x)
+    {
+      uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      return z ^ (z >> 31);
+    }
+
+    // xoshiro256** random number engine. Every thread owns one, so
+    // generators running on different threads draw from independent
+    // streams and the state of a pipeline can be saved and restored.
+    struct Engine
+    {
+      std::array<uint64_t, 4> s {};
+
+      explicit constexpr Engine(uint64_t seed = 1)
+      {
+        reseed(seed);
+      }
+
+      constexpr void reseed(uint64_t seed)
+      {
+        for (auto & word : s)
+          word = splitmix64(seed);
+      }
+
+      constexpr uint64_t next()
+      {
+        const uint64_t result = rotl(s[1] * 5, 7) * 9;
+        const uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+      }
+
+    private:
+      static constexpr uint64_t rotl(uint64_t x, int k)
+      {
+        return (x << k) | (x >> (64 - k));
+      }
+    };
+
+    Engine & engine()
+    {
+      thread_local Engine e;
+      return e;
+    }
+
+    // Seed of the index-th independent sub-stream derived from base.
+    uint64_t stream_seed(uint64_t base, uint64_t index)
+    {
+      uint64_t x = base ^ splitmix64(index);
+      return splitmix64(x);
+    }
+
+    // Runs func(worker) for worker = 0..threads-1, worker 0 on the
+    // calling thread. The random engine of the calling thread is left
+    // as it was. An exception thrown by any worker is rethrown here
+    // after all workers have finished (the lowest worker's first).
+    template <class Func>
+    void parallel_for(unsigned threads, Func&& func)
+    {
+      if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+      std::vector<std::exception_ptr> errors(threads);
+      {
+        // joins the workers even when starting one of them fails
+        struct joiner
+        {
+          std::vector<std::thread> workers;
+
+          ~joiner()
+          {
+            for (auto & worker : workers)
+              worker.join();
+          }
+        } pool;
+
+        pool.workers.reserve(threads - 1);
+        for (unsigned w = 1; w < threads; ++w)
+          pool.workers.emplace_back([&func, &errors, w]() {
+            try {
+              func(w);
+            }
+            catch (...) {
+              errors[w] = std::current_exception();
+            }
+          });
+
+        auto saved = engine().s;
+        try {
+          func(0u);
+        }
+        catch (...) {
+          errors[0] = std::current_exception();
+        }
+        engine().s = saved;
+      }
+
+      for (auto & error : errors)
+        if (error)
+          std::rethrow_exception(error);
+    }
+
+  } // namespace detail
+
+  // Seeds the random engine of the calling thread.
   void initialize(unsigned int seed = 0)
   {
     if (seed == 0)
       seed = (unsigned) time(NULL);
-    
-    srand(seed);
+
+    detail::engine().reseed(seed);
   }
 
-  int32_t random_int32()
+  namespace detail {
+
+    struct byte_source
+    {
+      const unsigned char * data;
+      size_t size;
+      size_t pos;
+    };
+
+    byte_source *& active_byte_source()
+    {
+      thread_local byte_source * source = nullptr;
+      return source;
+    }
+
+    // The next count bytes as a little-endian number; bytes past the
+    // end read as zero.
+    uint64_t take_bytes(byte_source & source, unsigned count)
+    {
+      uint64_t value = 0;
+      for (unsigned i = 0; i < count && source.pos < source.size; ++i)
+        value |= static_cast<uint64_t>(source.data[source.pos++]) << (8 * i);
+      return value;
+    }
+
+  } // namespace detail
+
+  // While alive, random draws on the calling thread read the given
+  // bytes instead of the engine, e.g. the input of a coverage-guided
+  // fuzzer. random_below consumes only the bytes it needs. Once the
+  // bytes run out every draw is zero, which selects the first choice
+  // and the shortest length, so generation still terminates. Scopes
+  // nest.
+  class byte_entropy
   {
-    return rand();
-  }
+    detail::byte_source source_;
+    detail::byte_source * previous_;
 
-#else
-  void initialize(unsigned int seed = 0)
+  public:
+
+    byte_entropy(const void * data, size_t size)
+      : source_ { static_cast<const unsigned char *>(data), size, 0 },
+        previous_(detail::active_byte_source())
+    {
+      detail::active_byte_source() = &source_;
+    }
+
+    byte_entropy(const byte_entropy &) = delete;
+    byte_entropy & operator = (const byte_entropy &) = delete;
+
+    ~byte_entropy()
+    {
+      detail::active_byte_source() = previous_;
+    }
+
+    size_t consumed() const
+    {
+      return source_.pos;
+    }
+
+    bool exhausted() const
+    {
+      return source_.pos == source_.size;
+    }
+  };
+
+  // Non-negative 31-bit random number (the range of POSIX random()).
+  int random_int32()
   {
-    if (seed == 0)
-      seed = (unsigned) time(NULL);
+    if (detail::byte_source * source = detail::active_byte_source())
+      return static_cast<int>(detail::take_bytes(*source, 4) & 0x7fffffff);
+    return static_cast<int>(detail::engine().next() >> 33);
+  }
 
-    srandom(seed);
+  uint64_t random_uint64()
+  {
+    if (detail::byte_source * source = detail::active_byte_source())
+      return detail::take_bytes(*source, 8);
+    return detail::engine().next();
   }
 
-  int random_int32()
+  // Uniform in [0, n); n == 0 is an empty range and throws
+  // invalid_argument. The engine path uses multiply-shift on 32 bits
+  // when n fits; a byte source gives up only as many bytes as n - 1
+  // needs, one for a coin flip or a short length.
+  uint64_t random_below(uint64_t n)
   {
-    return static_cast<int>(random());
+    if (n == 0)
+      throw std::invalid_argument("random_below: empty range");
+    if (detail::byte_source * source = detail::active_byte_source())
+    {
+      unsigned count = 0;
+      for (uint64_t max = n - 1; max != 0; max >>= 8)
+        ++count;
+      return count ? detail::take_bytes(*source, count) % n : 0;
+    }
+    const uint64_t bits = detail::engine().next();
+    return n <= (uint64_t(1) << 32) ? ((bits >> 32) * n) >> 32 : bits % n;
   }
-#endif // WIN32
 
   template <class GenFunc>
-  auto make_gen_from(GenFunc&& func);
+  constexpr auto make_gen_from(GenFunc&& func);
 
   template <class T>
   struct GenFactory
@@ -60,507 +281,2481 @@ namespace gen {
     static auto make();
   };
 
-  template <class T, class GenFunc>
-  class Gen : GenFunc
+  // Bounds on the number of values a generator has left. upper is
+  // exact for finite sources such as take(n), make_inorder_gen or a
+  // bounded make_stepper_gen; lower == unbounded means infinite.
+  struct size_bounds
   {
-  public:
-    typedef T value_type;
+    static constexpr size_t unbounded = std::numeric_limits<size_t>::max();
 
-    explicit Gen(GenFunc& func)
-      : GenFunc(func)
-    { }
-
-    explicit Gen(GenFunc&& func)
-      : GenFunc(std::move(func))
-    { }
+    size_t lower;
+    size_t upper;
 
-    T generate()
+    static constexpr size_bounds exact(size_t n)
     {
-      return GenFunc::operator()();
+      return size_bounds { n, n };
     }
 
-    gen_iterator<T, Gen> begin() 
+    static constexpr size_bounds unknown()
     {
-      return gen_iterator<T, Gen>(*this, false);
+      return size_bounds { 0, unbounded };
     }
 
-    gen_iterator<T, Gen> end() 
+    static constexpr size_bounds infinite()
     {
-      return gen_iterator<T, Gen>(*this, true);
+      return size_bounds { unbounded, unbounded };
     }
 
-    template <class Func>
-    auto map(Func&& func)
+    bool is_exact() const
     {
-      return make_gen_from(
-                [self = std::move(*this),
-                 func = std::forward<Func>(func)]() mutable {
-                    return func(self.generate());
-                });
+      return lower == upper;
     }
+  };
 
-    template <class Zipper, class... GenList>
-    auto zip_with(Zipper&& func, GenList&&... genlist)
-    {
-      return make_gen_from(
-        [self = std::move(*this),
-         genlist...,
-         func = std::forward<Zipper>(func)]() mutable {
-            return func(self.generate(), genlist.generate()...);
-      });
-    }
+  // Non-owning view of size contiguous values, like C++20 std::span.
+  template <class T>
+  class span
+  {
+    T * data_;
+    size_t size_;
 
-    template <class UGen>
-    auto amb(UGen&& ugen) 
-    {
-      return make_gen_from(
-         [self = std::move(*this),
-          ugen = std::forward<UGen>(ugen)]() mutable {
-             return (random_int32() % 2) ? self.generate() : ugen.generate();
-      });
-    }
+  public:
 
-    auto take(size_t count) 
-    {
-      return make_gen_from(
-             [self = std::move(*this), count]() mutable {
-                if(count-- > 0)
-                {
-                  return self.generate();
-                }
-                else
-                  throw std::out_of_range("take: generate exceeded take");
-          });
-    }
+    typedef T element_type;
+    typedef std::remove_cv_t<T> value_type;
+    typedef T * iterator;
 
-    template <class ReducerFunc, class Seed>
-    auto reduce(ReducerFunc&& reducer, Seed&& seed) 
-    {
-      return make_gen_from(
-               [self = std::move(*this),
-                reducer = std::forward<ReducerFunc>(reducer), 
-                seed = std::forward<Seed>(seed),
-                done = false]() mutable {
-                  try {
-                    while(!done)
-                      seed = reducer(seed, self.generate());
-                  }
-                  catch(std::out_of_range &) {
-                    done = true;
-                    return seed;
-                  }
-                  throw std::out_of_range("reduction completed");
-                  return seed;
-          });
-    }
+    constexpr span()
+      : data_(nullptr),
+        size_(0)
+    { }
 
-    template <class UGen>
-    auto append(UGen&& ugen) 
-    {
-      return concat(std::forward<UGen>(ugen));
-    }
+    constexpr span(T * data, size_t size)
+      : data_(data),
+        size_(size)
+    { }
 
-    template <class UGen>
-    auto concat(UGen&& ugen) 
-    {
-      return make_gen_from(
-          [tgen = std::move(*this),
-           ugen = std::forward<UGen>(ugen),
-           tdone = false,
-           udone = false]() mutable {
-             if(!tdone)
-             {
-               try {
-                  return tgen.generate();
-               } 
-               catch(std::out_of_range &) {
-                 tdone = true;
-               }
-             }
-
-             if(!udone)
-             {
-               try {
-                  return ugen.generate();
-               } 
-               catch(std::out_of_range &) {
-                 udone = true;
-               }
-             }
-             
-             throw std::out_of_range("concat: both generators completed!");
-          });
-    }
+    constexpr T * data() const { return data_; }
+    constexpr size_t size() const { return size_; }
+    constexpr bool empty() const { return size_ == 0; }
+    constexpr T * begin() const { return data_; }
+    constexpr T * end() const { return data_ + size_; }
+    constexpr T & operator [] (size_t i) const { return data_[i]; }
+  };
 
-    template <class UGenFunc>
-    auto concat_map(UGenFunc&& ugenfunc) 
+  namespace detail {
+
+    constexpr size_t saturating_add(size_t a, size_t b)
     {
-      typedef decltype(ugenfunc(std::declval<T>())) UGenType;
-      return make_gen_from(
-          [tgen = std::move(*this),
-           ugenfunc = std::forward<UGenFunc>(ugenfunc),
-           //ugenopt  = boost::optional<UGenType>(),
-           ugenvec  = std::vector<UGenType>(),
-           tdone = false,
-           udone = true]() mutable {
-             if(!udone)
-             {
-               try {
-                 return ugenvec[0].generate();
-                 //return ugenopt->generate();
-               }
-               catch(std::out_of_range &) {
-                 udone = true;
-               }
-             }
-             while(!tdone && udone)
-             {
-               try {
-                 //ugenopt.emplace(ugenfunc(tgen.generate()));
-                 ugenvec.clear();
-                 ugenvec.emplace_back(ugenfunc(tgen.generate()));
-                 udone = false;
-               }
-               catch(std::out_of_range &) {
-                 tdone = true;
-                 throw;
-               }
-
-               if(!udone)
-               {
-                 try {
-                   return ugenvec[0].generate();
-                   //return ugenopt->generate();
-                 }
-                 catch(std::out_of_range &) {
-                   udone = true;
-                 }
-               }
-             }
-             throw std::out_of_range("concat_map completed");
-          });
+      return (a > size_bounds::unbounded - b) ? size_bounds::unbounded : a + b;
     }
 
-    std::vector<T> to_vector() 
+    constexpr size_bounds min_bounds(size_bounds a, size_bounds b)
     {
-      std::vector<T> v;
-      try {
-        while(true)
-          v.push_back(this->generate());
-      }
-      catch(std::out_of_range &)
-      {
-        return v;
-      }
-      return v;
+      return size_bounds { a.lower < b.lower ? a.lower : b.lower,
+                           a.upper < b.upper ? a.upper : b.upper };
     }
 
-  };
+    template <class GenFunc, class = void>
+    struct has_size_hint : std::false_type {};
 
-  template <class GenFunc>
-  auto make_gen_from(GenFunc&& func)
-  {
-    return Gen<decltype(func()), GenFunc>(std::forward<GenFunc>(func));
-  }
+    template <class GenFunc>
+    struct has_size_hint<GenFunc,
+      std::void_t<decltype(std::declval<const GenFunc &>().size_hint())>>
+      : std::true_type {};
 
-  template <class T>
-  auto make_constant_gen(T&& t)
-  {
-    return make_gen_from([t = std::forward<T>(t)]() { return t; });
-  }
+    template <class GenFunc, class = void>
+    struct has_columns : std::false_type {};
 
-  template <class T>
-  auto make_empty_gen()
-  {
-    return make_gen_from([]() -> T { 
-        throw std::out_of_range("empty generator!"); 
-        //return std::declval<T>(); //did not work for int!!
-        return *static_cast<T *>(nullptr);
-      });
-  }
+    template <class GenFunc>
+    struct has_columns<GenFunc,
+      std::void_t<decltype(std::declval<GenFunc &>().columns(size_t()))>>
+      : std::true_type {};
 
-  template <class T>
-  auto make_single_gen(T&& t)
-  {
-    return make_gen_from([t = std::forward<T>(t), done = false]() mutable {
-        if(!done)
+    template <class GenFunc, class = void>
+    struct has_batch : std::false_type {};
+
+    template <class GenFunc>
+    struct has_batch<GenFunc,
+      std::void_t<decltype(std::declval<GenFunc &>().batch(size_t()))>>
+      : std::true_type {};
+
+    template <class GenFunc, class T, class = void>
+    struct has_generate_into : std::false_type {};
+
+    template <class GenFunc, class T>
+    struct has_generate_into<GenFunc, T,
+      std::void_t<decltype(std::declval<GenFunc &>().generate_into(
+                             std::declval<T &>()))>>
+      : std::true_type {};
+
+    template <class GenFunc, class OutIter, class = void>
+    struct has_generate_n : std::false_type {};
+
+    template <class GenFunc, class OutIter>
+    struct has_generate_n<GenFunc, OutIter,
+      std::void_t<decltype(std::declval<GenFunc &>().generate_n(
+                             std::declval<OutIter>(), size_t()))>>
+      : std::true_type {};
+
+    template <class Container, class = void>
+    struct has_reserve : std::false_type {};
+
+    template <class Container>
+    struct has_reserve<Container,
+      std::void_t<decltype(std::declval<Container &>().reserve(size_t()))>>
+      : std::true_type {};
+
+    // Elements can be resized into existence and regenerated through a
+    // plain reference; not so for std::vector<bool> or element types
+    // without a default constructor.
+    template <class Container>
+    struct is_fillable_in_place
+      : std::integral_constant<bool,
+          std::is_default_constructible<typename Container::value_type>::value &&
+          std::is_same<typename Container::reference,
+                       typename Container::value_type &>::value>
+    {};
+
+    template <class T>
+    struct is_std_array : std::false_type {};
+
+    template <class T, size_t N>
+    struct is_std_array<std::array<T, N>> : std::true_type {};
+
+    template <class T>
+    struct is_pair_or_tuple : std::false_type {};
+
+    template <class T, class U>
+    struct is_pair_or_tuple<std::pair<T, U>> : std::true_type {};
+
+    template <class... Args>
+    struct is_pair_or_tuple<std::tuple<Args...>> : std::true_type {};
+
+    template <class T>
+    struct is_boost_optional : std::false_type {};
+
+    template <class T>
+    struct is_boost_optional<boost::optional<T>> : std::true_type {};
+
+    // Appends generator state to a binary blob. Values are written in
+    // native byte order; a blob is meant to be restored on the same
+    // platform by the same build.
+    class state_writer
+    {
+      std::string & blob_;
+
+    public:
+
+      explicit state_writer(std::string & blob)
+        : blob_(blob)
+      { }
+
+      template <class V>
+      void put(const V & val)
+      {
+        if constexpr (std::is_arithmetic<V>::value || std::is_enum<V>::value)
+          blob_.append(reinterpret_cast<const char *>(&val), sizeof(V));
+        else if constexpr (std::is_same<V, std::string>::value)
         {
-          done = true;
-          return t; 
+          put(static_cast<uint64_t>(val.size()));
+          blob_.append(val);
+        }
+        else if constexpr (is_boost_optional<V>::value)
+        {
+          put(static_cast<bool>(val));
+          if (val)
+            put(*val);
+        }
+        else if constexpr (is_pair_or_tuple<V>::value)
+          std::apply([this](const auto &... elems) { (put(elems), ...); }, val);
+        else if constexpr (is_std_array<V>::value)
+        {
+          for (const auto & elem : val)
+            put(elem);
         }
         else
-          throw std::out_of_range("single generator completed!");
-      });
-  }
-
-  template <class Integer>
-  auto make_range_gen(Integer lo, Integer hi)
-  {
-    return make_gen_from([lo, hi]() { 
-      return static_cast<Integer>(lo + random_int32() % (hi - lo)); 
-    });
-  }
-
-  auto make_printable_gen()
-  {
-    return make_gen_from([]() {
-      auto space = 32;
-      auto tilde = 126;
-      return static_cast<char>(space + random_int32() % (tilde + 1 - space));
-    });
-  }
+        {
+          put(static_cast<uint64_t>(val.size()));
+          for (const auto & elem : val)
+            put(elem);
+        }
+      }
+    };
 
-  auto make_ascii_gen()
-  {
-    return make_gen_from([]() {
-              return static_cast<char>(random_int32() % 128);
-           });
-  }
+    class state_reader
+    {
+      const std::string & blob_;
+      size_t pos_;
 
-  auto make_lowercase_gen()
-  {
-    return make_gen_from([]() {
-      return static_cast<char>('a' + random_int32() % ('z' + 1 - 'a'));
-    });
-  }
+      const char * take(size_t n)
+      {
+        if (blob_.size() - pos_ < n)
+          throw std::invalid_argument("restore: truncated generator state");
 
-  auto make_uppercase_gen()
-  {
-    return make_gen_from([]() {
-      return static_cast<char>('A' + random_int32() % ('Z' + 1 - 'A'));
-    });
-  }
+        const char * data = blob_.data() + pos_;
+        pos_ += n;
+        return data;
+      }
 
-  auto make_alpha_gen()
-  {
-    return make_gen_from([]() {
-      return (random_int32() % 2) ?
-        static_cast<char>('a' + random_int32() % ('z' + 1 - 'a')) :
-        static_cast<char>('A' + random_int32() % ('Z' + 1 - 'A'));
-    });
-  }
+    public:
 
-  auto make_digit_gen()
-  {
-    return make_gen_from([]() {
-      return static_cast<char>('0' + random_int32() % ('9' + 1 - '0'));
-    });
-  }
+      explicit state_reader(const std::string & blob)
+        : blob_(blob),
+          pos_(0)
+      { }
 
-  auto make_alphanum_gen()
-  {
-    return make_gen_from([]() {
-      if (random_int32() % 2)
+      bool done() const
       {
-        return (random_int32() % 2) ?
-          static_cast<char>('a' + random_int32() % ('z' + 1 - 'a')) :
-          static_cast<char>('A' + random_int32() % ('Z' + 1 - 'A'));
+        return pos_ == blob_.size();
       }
-      else
-        return static_cast<char>('0' + random_int32() % ('9' + 1 - '0'));
+
+      template <class V>
+      void get(V & val)
+      {
+        if constexpr (std::is_arithmetic<V>::value || std::is_enum<V>::value)
+          std::memcpy(&val, take(sizeof(V)), sizeof(V));
+        else if constexpr (std::is_same<V, std::string>::value)
+        {
+          uint64_t size;
+          get(size);
+          val.assign(take(size), size);
+        }
+        else if constexpr (is_boost_optional<V>::value)
+        {
+          bool engaged;
+          get(engaged);
+          val = boost::none;
+          if (engaged)
+          {
+            typename V::value_type elem;
+            get(elem);
+            val = std::move(elem);
+          }
+        }
+        else if constexpr (is_pair_or_tuple<V>::value)
+          std::apply([this](auto &... elems) { (get(elems), ...); }, val);
+        else if constexpr (is_std_array<V>::value)
+        {
+          for (auto & elem : val)
+            get(elem);
+        }
+        else
+        {
+          uint64_t size;
+          get(size);
+          val.clear();
+          for (uint64_t i = 0; i < size; ++i)
+          {
+            typename V::value_type elem;
+            get(elem);
+            val.insert(val.end(), std::move(elem));
+          }
+        }
+      }
+    };
+
+    // Stateful generator functions expose their position through
+    //   void save(state_writer &) const;
+    //   void load(state_reader &);
+    // Functions without them (e.g., plain lambdas) are stateless.
+    template <class GenFunc, class = void>
+    struct has_save : std::false_type {};
+
+    template <class GenFunc>
+    struct has_save<GenFunc,
+      std::void_t<decltype(std::declval<const GenFunc &>().save(
+                             std::declval<state_writer &>())),
+                  decltype(std::declval<GenFunc &>().load(
+                             std::declval<state_reader &>()))>>
+      : std::true_type {};
+
+    // A generator function has a position when its next value depends
+    // on how many values it produced before, not only on the random
+    // engine. That is assumed for every function with saved state;
+    // combinators derive
+    //   static constexpr bool has_position
+    // from their inner generators instead.
+    template <class GenFunc, class = void>
+    struct has_position : has_save<GenFunc> {};
+
+    template <class GenFunc>
+    struct has_position<GenFunc, std::void_t<decltype(GenFunc::has_position)>>
+      : std::integral_constant<bool, GenFunc::has_position> {};
+
+    // borrow() and share() wrappers: their copies all advance one
+    // generator, so they must stay on one thread.
+    template <class GenFunc, class = void>
+    struct shares_state : std::false_type {};
+
+    template <class GenFunc>
+    struct shares_state<GenFunc, std::void_t<decltype(GenFunc::shares_state)>>
+      : std::integral_constant<bool, GenFunc::shares_state> {};
+
+    template <class GenFunc, class = void>
+    struct has_skip : std::false_type {};
+
+    template <class GenFunc>
+    struct has_skip<GenFunc,
+      std::void_t<decltype(std::declval<GenFunc &>().skip(size_t()))>>
+      : std::true_type {};
+
+    template <class TGen, class Func>
+    class MapGen;
+
+    template <class TGen, class UGen>
+    class AmbGen;
+
+    template <class TGen>
+    class TakeGen;
+
+    template <class TGen, class ReducerFunc, class Seed>
+    class ReduceGen;
+
+    template <class TGen>
+    class ChunkGen;
+
+    template <class TGen>
+    class WindowGen;
+
+    template <class TGen, class UGen>
+    class ConcatGen;
+
+    template <class TGen, class UGenFunc>
+    class ConcatMapGen;
+
+  } // namespace detail
+
+  template <class T, class GenFunc>
+  class Gen : GenFunc
+  {
+  public:
+    typedef T value_type;
+
+    explicit constexpr Gen(GenFunc& func)
+      : GenFunc(func)
+    { }
+
+    explicit constexpr Gen(GenFunc&& func)
+      : GenFunc(std::move(func))
+    { }
+
+    constexpr T generate()
+    {
+      return GenFunc::operator()();
+    }
+
+    // Overwrites out with the next value. String, sequence, array,
+    // optional, pair and tuple generators reuse the memory out already
+    // owns (string/container capacity, engaged optionals), recursively,
+    // so a consumer can recycle one record object.
+    constexpr void generate_into(T & out)
+    {
+      if constexpr (detail::has_generate_into<GenFunc, T>::value)
+        GenFunc::generate_into(out);
+      else
+        out = generate();
+    }
+
+    // Writes the next n values to out. Generators with a faster bulk
+    // path (e.g., one that draws several values at once) provide their
+    // own generate_n.
+    template <class OutIter>
+    OutIter generate_n(OutIter out, size_t n)
+    {
+      if constexpr (detail::has_generate_n<GenFunc, OutIter>::value)
+        return GenFunc::generate_n(out, n);
+      else
+      {
+        for (size_t i = 0; i < n; ++i)
+          *out++ = generate();
+        return out;
+      }
+    }
+
+    // Zip generators (make_zip_gen, make_composed_gen, make_tuple_gen,
+    // zip_with) return a tuple of n-element vectors: one contiguous
+    // column per field generator. Each column is filled by its own
+    // generator in a tight loop.
+    template <class F = GenFunc>
+    auto generate_columns(size_t n) -> decltype(std::declval<F &>().columns(n))
+    {
+      return F::columns(n);
+    }
+
+    // Returns the next n values. Zip generators fill columns first and
+    // transpose them into records at the end.
+    std::vector<T> generate_batch(size_t n)
+    {
+      if constexpr (detail::has_batch<GenFunc>::value)
+        return GenFunc::batch(n);
+      else
+      {
+        std::vector<T> v;
+        v.reserve(n);
+        generate_n(std::back_inserter(v), n);
+        return v;
+      }
+    }
+
+    // Serializes the position of every stateful generator in the
+    // pipeline (stepper position, take counters, inorder index,
+    // concat/concat_map progress, ...) and the random engine of the
+    // calling thread. Restoring the blob into an identically composed
+    // pipeline resumes the exact same sequence. Lambdas passed to
+    // make_gen_from and map are assumed to be stateless.
+    std::string snapshot() const
+    {
+      std::string blob;
+      detail::state_writer writer(blob);
+      save(writer);
+      writer.put(detail::engine().s);
+      return blob;
+    }
+
+    void restore(const std::string & state)
+    {
+      detail::state_reader reader(state);
+      load(reader);
+      reader.get(detail::engine().s);
+      if (!reader.done())
+        throw std::invalid_argument("restore: generator state does not match the pipeline");
+    }
+
+    void save(detail::state_writer & writer) const
+    {
+      if constexpr (detail::has_save<GenFunc>::value)
+        GenFunc::save(writer);
+    }
+
+    static constexpr bool has_position = detail::has_position<GenFunc>::value;
+    static constexpr bool shares_state = detail::shares_state<GenFunc>::value;
+
+    // Advances the position by count values as if they had been
+    // generated. Random draws are not replayed: generators without a
+    // position have nothing to advance, and positional generators that
+    // cannot jump (e.g., concat) generate and drop count values.
+    void skip(size_t count)
+    {
+      if constexpr (detail::has_skip<GenFunc>::value)
+        GenFunc::skip(count);
+      else if constexpr (has_position)
+      {
+        for (size_t i = 0; i < count; ++i)
+          generate();
+      }
+    }
+
+    // Reduces the first n values generated from copies of this
+    // generator with an associative reducer, which must also accept a
+    // partial result as its second argument. Values are split into
+    // fixed blocks, each with its own engine sub-stream (the base seed
+    // is drawn from the calling thread's engine), and the block
+    // results are combined in a fixed tree order, so the result does
+    // not depend on the number of threads. With one thread no thread
+    // is started and the source is walked once without skipping.
+    // Generators containing borrow() or share() cannot be reduced in
+    // parallel: every copy would advance the same generator.
+    template <class Reducer, class Result>
+    Result parallel_reduce(size_t n, Reducer reducer, Result identity,
+                           unsigned threads = 0) const
+    {
+      static_assert(!detail::shares_state<GenFunc>::value,
+                    "parallel_reduce copies the generator per thread; "
+                    "borrowed and shared generators are single-threaded");
+      constexpr size_t BLOCK = 1 << 14;
+      const size_t nblocks = (n + BLOCK - 1) / BLOCK;
+      const uint64_t base = random_uint64();
+      std::vector<Result> partials(nblocks, identity);
+
+      if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+      threads = static_cast<unsigned>(std::min<size_t>(threads, std::max<size_t>(nblocks, 1)));
+
+      detail::parallel_for(threads, [&](unsigned worker) {
+        const size_t first = nblocks * worker / threads;
+        const size_t last = nblocks * (worker + 1) / threads;
+        Gen local(*this);
+        size_t b = 0;
+        Result acc = identity;
+        try {
+          // blocks are skipped under their own seeds so that
+          // generators replaying values see the same draws
+          for (; b < first; ++b)
+          {
+            detail::engine().reseed(detail::stream_seed(base, b));
+            local.skip(BLOCK);
+          }
+          for (; b < last; ++b)
+          {
+            detail::engine().reseed(detail::stream_seed(base, b));
+            const size_t count = std::min(BLOCK, n - b * BLOCK);
+            acc = identity;
+            for (size_t i = 0; i < count; ++i)
+              acc = reducer(std::move(acc), local.generate());
+            partials[b] = std::move(acc);
+          }
+        }
+        catch (std::out_of_range &) {
+          // the source ended inside block b; later blocks stay empty
+          if (b >= first && b < last)
+            partials[b] = std::move(acc);
+        }
+      });
+
+      for (size_t width = 1; width < nblocks; width *= 2)
+        for (size_t i = 0; i + width < nblocks; i += 2 * width)
+          partials[i] = reducer(std::move(partials[i]), std::move(partials[i + width]));
+
+      return nblocks ? partials[0] : identity;
+    }
+
+    void load(detail::state_reader & reader)
+    {
+      if constexpr (detail::has_save<GenFunc>::value)
+        GenFunc::load(reader);
+    }
+
+#ifdef GEN_HAS_RANGES
+    // Gen models std::ranges::input_range: a move-only iterator that
+    // owns the current value (so it can be moved out) and a
+    // default_sentinel end.
+    gen_input_iterator<T, Gen> begin()
+    {
+      gen_input_iterator<T, Gen> iter(*this);
+      ++iter;
+      return iter;
+    }
+
+    std::default_sentinel_t end()
+    {
+      return std::default_sentinel;
+    }
+#else
+    gen_iterator<T, Gen> begin() 
+    {
+      return gen_iterator<T, Gen>(*this, false);
+    }
+
+    gen_iterator<T, Gen> end() 
+    {
+      return gen_iterator<T, Gen>(*this, true);
+    }
+#endif // GEN_HAS_RANGES
+
+    template <class Func>
+    constexpr auto map(Func&& func)
+    {
+      return make_gen_from(
+        detail::MapGen<Gen, std::decay_t<Func>>(
+          std::move(*this), std::forward<Func>(func)));
+    }
+
+    template <class Zipper, class... GenList>
+    auto zip_with(Zipper&& func, GenList&&... genlist);
+
+    template <class UGen>
+    auto amb(UGen&& ugen) 
+    {
+      return make_gen_from(
+        detail::AmbGen<Gen, std::decay_t<UGen>>(
+          std::move(*this), std::forward<UGen>(ugen)));
+    }
+
+    constexpr auto take(size_t count)
+    {
+      return make_gen_from(detail::TakeGen<Gen>(std::move(*this), count));
+    }
+
+    // Spans of the next n values. Every span views the same internal
+    // buffer and stays valid until the next call; a finite source ends
+    // with a shorter chunk.
+    auto chunk(size_t n)
+    {
+      return make_gen_from(detail::ChunkGen<Gen>(std::move(*this), n));
+    }
+
+    // Spans of n consecutive values, the window advancing by step each
+    // time (step > n skips values). Incomplete windows at the end of a
+    // finite source are dropped.
+    auto window(size_t n, size_t step = 1)
+    {
+      return make_gen_from(detail::WindowGen<Gen>(std::move(*this), n, step));
+    }
+
+    // Calls callback(span) for consecutive chunks of n values until the
+    // source ends or callback returns false, in O(n) memory even for
+    // infinite sources. Returns the number of values passed.
+    template <class Callback>
+    size_t to_chunks(size_t n, Callback&& callback)
+    {
+      auto chunks = chunk(n);
+      size_t total = 0;
+      while (true)
+      {
+        // only the source's out_of_range ends the loop; one thrown by
+        // callback propagates
+        span<T> values;
+        try {
+          values = chunks.generate();
+        }
+        catch (std::out_of_range &)
+        {
+          return total;
+        }
+        total += values.size();
+        if constexpr (std::is_same<decltype(callback(values)), bool>::value)
+        {
+          if (!callback(values))
+            return total;
+        }
+        else
+          callback(values);
+      }
+    }
+
+    template <class ReducerFunc, class Seed>
+    auto reduce(ReducerFunc&& reducer, Seed&& seed) 
+    {
+      return make_gen_from(
+        detail::ReduceGen<Gen, std::decay_t<ReducerFunc>, std::decay_t<Seed>>(
+          std::move(*this),
+          std::forward<ReducerFunc>(reducer),
+          std::forward<Seed>(seed)));
+    }
+
+    template <class UGen>
+    auto append(UGen&& ugen) 
+    {
+      return concat(std::forward<UGen>(ugen));
+    }
+
+    template <class UGen>
+    auto concat(UGen&& ugen) 
+    {
+      return make_gen_from(
+        detail::ConcatGen<Gen, std::decay_t<UGen>>(
+          std::move(*this), std::forward<UGen>(ugen)));
+    }
+
+    template <class UGenFunc>
+    auto concat_map(UGenFunc&& ugenfunc) 
+    {
+      return make_gen_from(
+        detail::ConcatMapGen<Gen, std::decay_t<UGenFunc>>(
+          std::move(*this), std::forward<UGenFunc>(ugenfunc)));
+    }
+
+    // Propagated by every combinator: sum for concat, min for zip,
+    // passthrough for map, clamped by take, ... Plain lambdas report
+    // size_bounds::unknown().
+    size_bounds size_hint() const
+    {
+      if constexpr (detail::has_size_hint<GenFunc>::value)
+        return GenFunc::size_hint();
+      else
+        return size_bounds::unknown();
+    }
+
+    std::vector<T> to_vector() 
+    {
+      std::vector<T> v;
+      const size_bounds hint = size_hint();
+      // a loose upper bound may be far beyond what the source yields
+      if (hint.is_exact() && hint.upper != size_bounds::unbounded)
+        v.reserve(hint.upper);
+      else if (hint.lower != size_bounds::unbounded)
+        v.reserve(hint.lower);
+      try {
+        while(true)
+          v.push_back(this->generate());
+      }
+      catch(std::out_of_range &)
+      {
+        return v;
+      }
+      return v;
+    }
+
+  };
+
+  template <class GenFunc>
+  constexpr auto make_gen_from(GenFunc&& func)
+  {
+    return Gen<decltype(func()), GenFunc>(std::forward<GenFunc>(func));
+  }
+
+  namespace detail {
+
+    template <class TGen, class Func>
+    class MapGen
+    {
+      TGen self_;
+      Func func_;
+
+    public:
+
+      static constexpr bool has_position = TGen::has_position;
+
+      template <class F>
+      constexpr MapGen(TGen&& self, F&& func)
+        : self_(std::move(self)),
+          func_(std::forward<F>(func))
+      { }
+
+      constexpr auto operator()()
+      {
+        return func_(self_.generate());
+      }
+
+      void skip(size_t count)
+      {
+        self_.skip(count);
+      }
+
+      size_bounds size_hint() const
+      {
+        return self_.size_hint();
+      }
+
+      void save(state_writer & writer) const
+      {
+        self_.save(writer);
+      }
+
+      void load(state_reader & reader)
+      {
+        self_.load(reader);
+      }
+    };
+
+    template <class TGen, class UGen>
+    class AmbGen
+    {
+      TGen tgen_;
+      UGen ugen_;
+
+    public:
+
+      static constexpr bool has_position =
+        TGen::has_position || UGen::has_position;
+
+      template <class U>
+      AmbGen(TGen&& tgen, U&& ugen)
+        : tgen_(std::move(tgen)),
+          ugen_(std::forward<U>(ugen))
+      { }
+
+      auto operator()()
+      {
+        return random_below(2) ? tgen_.generate() : ugen_.generate();
+      }
+
+      size_bounds size_hint() const
+      {
+        const size_bounds t = tgen_.size_hint();
+        const size_bounds u = ugen_.size_hint();
+        return size_bounds { std::min(t.lower, u.lower),
+                             saturating_add(t.upper, u.upper) };
+      }
+
+      void save(state_writer & writer) const
+      {
+        tgen_.save(writer);
+        ugen_.save(writer);
+      }
+
+      void load(state_reader & reader)
+      {
+        tgen_.load(reader);
+        ugen_.load(reader);
+      }
+    };
+
+    template <class TGen>
+    class TakeGen
+    {
+      TGen self_;
+      size_t count_;
+
+    public:
+
+      constexpr TakeGen(TGen&& self, size_t count)
+        : self_(std::move(self)),
+          count_(count)
+      { }
+
+      constexpr auto operator()()
+      {
+        if(count_ > 0)
+        {
+          --count_;
+          return self_.generate();
+        }
+        else
+          throw std::out_of_range("take: generate exceeded take");
+      }
+
+      void skip(size_t count)
+      {
+        const size_t n = count < count_ ? count : count_;
+        count_ -= n;
+        self_.skip(n);
+        if(n < count)
+          throw std::out_of_range("take: skip exceeded take");
+      }
+
+      size_bounds size_hint() const
+      {
+        return min_bounds(self_.size_hint(), size_bounds::exact(count_));
+      }
+
+      template <class U>
+      void generate_into(U & out)
+      {
+        if(count_ > 0)
+        {
+          --count_;
+          self_.generate_into(out);
+        }
+        else
+          throw std::out_of_range("take: generate exceeded take");
+      }
+
+      void save(state_writer & writer) const
+      {
+        self_.save(writer);
+        writer.put(static_cast<uint64_t>(count_));
+      }
+
+      void load(state_reader & reader)
+      {
+        uint64_t count;
+        self_.load(reader);
+        reader.get(count);
+        count_ = static_cast<size_t>(count);
+      }
+    };
+
+    // Output iterator storing to consecutive elements from data and
+    // counting the stores, so that a generate_n ended by out_of_range
+    // leaves a known number of values behind.
+    template <class T>
+    class counting_writer
+    {
+      T * data_;
+      size_t * count_;
+
+    public:
+
+      typedef std::output_iterator_tag iterator_category;
+      typedef void value_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef void pointer;
+      typedef void reference;
+
+      counting_writer(T * data, size_t & count)
+        : data_(data),
+          count_(&count)
+      { }
+
+      counting_writer & operator = (const T & value)
+      {
+        data_[(*count_)++] = value;
+        return *this;
+      }
+
+      counting_writer & operator * () { return *this; }
+      counting_writer & operator ++ () { return *this; }
+      counting_writer & operator ++ (int) { return *this; }
+    };
+
+    // Fixed number of values owned through a plain array and copied
+    // deeply. Unlike std::vector<bool> it has data() for every T, so
+    // chunks and windows can view it as a span.
+    template <class T>
+    class value_buffer
+    {
+      std::unique_ptr<T[]> data_;
+      size_t size_;
+
+    public:
+
+      explicit value_buffer(size_t size)
+        : data_(new T[size]()),
+          size_(size)
+      { }
+
+      value_buffer(const value_buffer & other)
+        : value_buffer(other.size_)
+      {
+        std::copy(other.begin(), other.end(), begin());
+      }
+
+      value_buffer(value_buffer && other) noexcept
+        : data_(std::move(other.data_)),
+          size_(std::exchange(other.size_, 0))
+      { }
+
+      value_buffer & operator = (value_buffer other) noexcept
+      {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        return *this;
+      }
+
+      size_t size() const { return size_; }
+      T * data() { return data_.get(); }
+      T * begin() { return data_.get(); }
+      T * end() { return data_.get() + size_; }
+      const T * begin() const { return data_.get(); }
+      const T * end() const { return data_.get() + size_; }
+      T & operator [] (size_t i) { return data_[i]; }
+    };
+
+    template <class TGen>
+    class ChunkGen
+    {
+      typedef typename TGen::value_type T;
+
+      TGen self_;
+      value_buffer<T> buffer_;
+
+    public:
+
+      static constexpr bool has_position = TGen::has_position;
+
+      ChunkGen(TGen&& self, size_t n)
+        : self_(std::move(self)),
+          buffer_(n)
+      {
+        if (n == 0)
+          throw std::invalid_argument("chunk: size must be positive");
+      }
+
+      span<T> operator()()
+      {
+        const size_t n = buffer_.size();
+        if (self_.size_hint().lower >= n)
+        {
+          self_.generate_n(buffer_.begin(), n);
+          return span<T>(buffer_.data(), n);
+        }
+
+        // Sources of unknown length (plain lambdas) still fill plain
+        // values in bulk; the writer counts what arrived before the
+        // end. Other values are regenerated in place to reuse memory.
+        size_t filled = 0;
+        try {
+          if constexpr (std::is_trivially_copyable<T>::value)
+            self_.generate_n(counting_writer<T>(buffer_.data(), filled), n);
+          else
+            for (; filled < n; ++filled)
+              self_.generate_into(buffer_[filled]);
+        }
+        catch (std::out_of_range &)
+        {
+          if (filled == 0)
+            throw;
+        }
+        return span<T>(buffer_.data(), filled);
+      }
+
+      void skip(size_t count)
+      {
+        self_.skip(count * buffer_.size());
+      }
+
+      size_bounds size_hint() const
+      {
+        const size_bounds hint = self_.size_hint();
+        const size_t n = buffer_.size();
+        auto chunks = [n](size_t values) {
+          return values == size_bounds::unbounded ? values : (values + n - 1) / n;
+        };
+        return size_bounds { chunks(hint.lower), chunks(hint.upper) };
+      }
+
+      void save(state_writer & writer) const
+      {
+        self_.save(writer);
+      }
+
+      void load(state_reader & reader)
+      {
+        self_.load(reader);
+      }
+    };
+
+    // Mirrored ring buffer: the value at ring position p is stored at
+    // both p and p + n of a 2n buffer, so the window starting at the
+    // oldest value is always contiguous and advancing never moves the
+    // other values.
+    template <class TGen>
+    class WindowGen
+    {
+      typedef typename TGen::value_type T;
+
+      TGen self_;
+      value_buffer<T> buffer_;
+      size_t n_;
+      size_t step_;
+      size_t head_;
+      bool primed_;
+
+      void push()
+      {
+        self_.generate_into(buffer_[head_]);
+        buffer_[head_ + n_] = buffer_[head_];
+        head_ = (head_ + 1) % n_;
+      }
+
+    public:
+
+      static constexpr bool has_position = TGen::has_position;
+
+      WindowGen(TGen&& self, size_t n, size_t step)
+        : self_(std::move(self)),
+          buffer_(2 * n),
+          n_(n),
+          step_(step),
+          head_(0),
+          primed_(false)
+      {
+        if (n == 0 || step == 0)
+          throw std::invalid_argument("window: size and step must be positive");
+      }
+
+      span<T> operator()()
+      {
+        const size_t count = primed_ ? step_ : n_;
+        for (size_t i = 0; i < count; ++i)
+          push();
+        primed_ = true;
+        return span<T>(buffer_.data() + head_, n_);
+      }
+
+      size_bounds size_hint() const
+      {
+        const size_bounds hint = self_.size_hint();
+        const size_t n = n_, step = step_;
+        const bool primed = primed_;
+        auto windows = [n, step, primed](size_t values) {
+          if (values == size_bounds::unbounded)
+            return values;
+          if (primed)
+            return values / step;
+          return values < n ? 0 : (values - n) / step + 1;
+        };
+        return size_bounds { windows(hint.lower), windows(hint.upper) };
+      }
+
+      void save(state_writer & writer) const
+      {
+        self_.save(writer);
+        writer.put(buffer_);
+        writer.put(static_cast<uint64_t>(head_));
+        writer.put(primed_);
+      }
+
+      void load(state_reader & reader)
+      {
+        uint64_t head;
+        uint64_t size;
+        self_.load(reader);
+        reader.get(size);
+        if (size != buffer_.size())
+          throw std::invalid_argument("restore: generator state does not match the pipeline");
+        for (T & value : buffer_)
+          reader.get(value);
+        reader.get(head);
+        reader.get(primed_);
+        head_ = static_cast<size_t>(head);
+      }
+    };
+
+    template <class TGen, class ReducerFunc, class Seed>
+    class ReduceGen
+    {
+      TGen self_;
+      ReducerFunc reducer_;
+      Seed seed_;
+      bool done_;
+
+    public:
+
+      template <class R, class S>
+      ReduceGen(TGen&& self, R&& reducer, S&& seed)
+        : self_(std::move(self)),
+          reducer_(std::forward<R>(reducer)),
+          seed_(std::forward<S>(seed)),
+          done_(false)
+      { }
+
+      Seed operator()()
+      {
+        try {
+          while(!done_)
+            seed_ = reducer_(seed_, self_.generate());
+        }
+        catch(std::out_of_range &) {
+          done_ = true;
+          return seed_;
+        }
+        throw std::out_of_range("reduction completed");
+      }
+
+      size_bounds size_hint() const
+      {
+        return size_bounds::exact(done_ ? 0 : 1);
+      }
+
+      void save(state_writer & writer) const
+      {
+        self_.save(writer);
+        writer.put(seed_);
+        writer.put(done_);
+      }
+
+      void load(state_reader & reader)
+      {
+        self_.load(reader);
+        reader.get(seed_);
+        reader.get(done_);
+      }
+    };
+
+    template <class TGen, class UGen>
+    class ConcatGen
+    {
+      TGen tgen_;
+      UGen ugen_;
+      bool tdone_;
+      bool udone_;
+
+    public:
+
+      template <class U>
+      ConcatGen(TGen&& tgen, U&& ugen)
+        : tgen_(std::move(tgen)),
+          ugen_(std::forward<U>(ugen)),
+          tdone_(false),
+          udone_(false)
+      { }
+
+      auto operator()()
+      {
+        if(!tdone_)
+        {
+          try {
+            return tgen_.generate();
+          }
+          catch(std::out_of_range &) {
+            tdone_ = true;
+          }
+        }
+
+        if(!udone_)
+        {
+          try {
+            return ugen_.generate();
+          }
+          catch(std::out_of_range &) {
+            udone_ = true;
+          }
+        }
+
+        throw std::out_of_range("concat: both generators completed!");
+      }
+
+      size_bounds size_hint() const
+      {
+        const size_bounds t = tdone_ ? size_bounds::exact(0) : tgen_.size_hint();
+        const size_bounds u = udone_ ? size_bounds::exact(0) : ugen_.size_hint();
+        return size_bounds { saturating_add(t.lower, u.lower),
+                             saturating_add(t.upper, u.upper) };
+      }
+
+      void save(state_writer & writer) const
+      {
+        tgen_.save(writer);
+        ugen_.save(writer);
+        writer.put(tdone_);
+        writer.put(udone_);
+      }
+
+      void load(state_reader & reader)
+      {
+        tgen_.load(reader);
+        ugen_.load(reader);
+        reader.get(tdone_);
+        reader.get(udone_);
+      }
+    };
+
+    // The inner generator is rebuilt on restore by applying ugenfunc to
+    // the saved source value, so the source value type must be
+    // serializable by state_writer.
+    template <class TGen, class UGenFunc>
+    class ConcatMapGen
+    {
+      typedef typename TGen::value_type T;
+      typedef decltype(std::declval<UGenFunc &>()(std::declval<T>())) UGenType;
+
+      TGen tgen_;
+      UGenFunc ugenfunc_;
+      std::vector<UGenType> ugenvec_;
+      boost::optional<T> source_;
+      bool tdone_;
+      bool udone_;
+
+    public:
+
+      template <class F>
+      ConcatMapGen(TGen&& tgen, F&& ugenfunc)
+        : tgen_(std::move(tgen)),
+          ugenfunc_(std::forward<F>(ugenfunc)),
+          tdone_(false),
+          udone_(true)
+      { }
+
+      auto operator()()
+      {
+        if(!udone_)
+        {
+          try {
+            return ugenvec_[0].generate();
+          }
+          catch(std::out_of_range &) {
+            udone_ = true;
+          }
+        }
+        while(!tdone_ && udone_)
+        {
+          try {
+            source_.emplace(tgen_.generate());
+            ugenvec_.clear();
+            ugenvec_.emplace_back(ugenfunc_(T(*source_)));
+            udone_ = false;
+          }
+          catch(std::out_of_range &) {
+            tdone_ = true;
+            throw;
+          }
+
+          if(!udone_)
+          {
+            try {
+              return ugenvec_[0].generate();
+            }
+            catch(std::out_of_range &) {
+              udone_ = true;
+            }
+          }
+        }
+        throw std::out_of_range("concat_map completed");
+      }
+
+      size_bounds size_hint() const
+      {
+        const size_bounds inner = (udone_ || ugenvec_.empty())
+                                    ? size_bounds::exact(0)
+                                    : ugenvec_[0].size_hint();
+        if(tdone_)
+          return inner;
+        return size_bounds { inner.lower, size_bounds::unbounded };
+      }
+
+      void save(state_writer & writer) const
+      {
+        tgen_.save(writer);
+        writer.put(tdone_);
+        writer.put(udone_);
+        writer.put(source_);
+        if(!ugenvec_.empty())
+          ugenvec_[0].save(writer);
+      }
+
+      void load(state_reader & reader)
+      {
+        tgen_.load(reader);
+        reader.get(tdone_);
+        reader.get(udone_);
+        reader.get(source_);
+        ugenvec_.clear();
+        if(source_)
+        {
+          ugenvec_.emplace_back(ugenfunc_(T(*source_)));
+          ugenvec_[0].load(reader);
+        }
+      }
+    };
+
+    // Owns the inner generators of a combinator. func(out, gens...)
+    // overwrites out with the next value and carries only
+    // configuration, so saving and restoring the inner generators
+    // captures the whole state. generate() fills a fresh T while
+    // generate_into() reuses the memory of an existing one.
+    template <class T, class Func, class... GenList>
+    class NestedGen
+    {
+      std::tuple<GenList...> genlist_;
+      Func func_;
+
+    public:
+
+      static constexpr bool has_position = (GenList::has_position || ...);
+
+      template <class F, class... G>
+      explicit constexpr NestedGen(F&& func, G&&... genlist)
+        : genlist_(std::forward<G>(genlist)...),
+          func_(std::forward<F>(func))
+      { }
+
+      constexpr T operator()()
+      {
+        T out {};
+        generate_into(out);
+        return out;
+      }
+
+      constexpr void generate_into(T & out)
+      {
+        std::apply([this, &out](auto &... gen) {
+          func_(out, gen...);
+        }, genlist_);
+      }
+
+      // Each value may consume any number of inner values, so the
+      // nested generator is only known to be infinite when all inner
+      // generators are.
+      size_bounds size_hint() const
+      {
+        const bool infinite = std::apply([](const auto &... gen) {
+          return ((gen.size_hint().lower == size_bounds::unbounded) && ...);
+        }, genlist_);
+        return infinite ? size_bounds::infinite() : size_bounds::unknown();
+      }
+
+      void save(state_writer & writer) const
+      {
+        std::apply([&writer](const auto &... gen) {
+          (gen.save(writer), ...);
+        }, genlist_);
+      }
+
+      void load(state_reader & reader)
+      {
+        std::apply([&reader](auto &... gen) {
+          (gen.load(reader), ...);
+        }, genlist_);
+      }
+    };
+
+    template <class T, class Func, class... GenList>
+    constexpr auto make_nested_gen(Func&& func, GenList&&... genlist)
+    {
+      return make_gen_from(
+        NestedGen<T, std::decay_t<Func>, std::decay_t<GenList>...>(
+          std::forward<Func>(func), std::forward<GenList>(genlist)...));
+    }
+
+    template <class T>
+    class SingleGen
+    {
+      T t_;
+      bool done_;
+
+    public:
+
+      template <class U>
+      explicit SingleGen(U&& t)
+        : t_(std::forward<U>(t)),
+          done_(false)
+      { }
+
+      T operator()()
+      {
+        if(!done_)
+        {
+          done_ = true;
+          return t_;
+        }
+        else
+          throw std::out_of_range("single generator completed!");
+      }
+
+      void skip(size_t count)
+      {
+        if(count > 0)
+        {
+          if(done_)
+            throw std::out_of_range("single generator completed!");
+          done_ = true;
+          if(count > 1)
+            throw std::out_of_range("single generator completed!");
+        }
+      }
+
+      size_bounds size_hint() const
+      {
+        return size_bounds::exact(done_ ? 0 : 1);
+      }
+
+      void save(state_writer & writer) const
+      {
+        writer.put(done_);
+      }
+
+      void load(state_reader & reader)
+      {
+        reader.get(done_);
+      }
+    };
+
+  } // namespace detail
+
+  template <class T>
+  auto make_constant_gen(T&& t)
+  {
+    return make_gen_from([t = std::forward<T>(t)]() { return t; });
+  }
+
+  template <class T>
+  auto make_empty_gen()
+  {
+    return make_gen_from([]() -> T { 
+        throw std::out_of_range("empty generator!"); 
+        //return std::declval<T>(); //did not work for int!!
+        return *static_cast<T *>(nullptr);
+      });
+  }
+
+  template <class T>
+  auto make_single_gen(T&& t)
+  {
+    return make_gen_from(detail::SingleGen<std::decay_t<T>>(std::forward<T>(t)));
+  }
+
+  template <class Integer>
+  auto make_range_gen(Integer lo, Integer hi)
+  {
+    return make_gen_from([lo, hi]() { 
+      return static_cast<Integer>(lo + random_below(static_cast<uint64_t>(hi - lo)));
+    });
+  }
+
+  namespace detail {
+
+    // Maps every 64-bit draw through func. generate_n draws a block of
+    // raw bits first and transforms it in a separate loop that the
+    // compiler can vectorize.
+    template <class T, class Func>
+    class BitsGen
+    {
+      Func func_;
+
+    public:
+
+      explicit BitsGen(Func func)
+        : func_(func)
+      { }
+
+      T operator()()
+      {
+        return func_(random_uint64());
+      }
+
+      size_bounds size_hint() const
+      {
+        return size_bounds::infinite();
+      }
+
+      template <class OutIter>
+      OutIter generate_n(OutIter out, size_t n)
+      {
+        constexpr size_t BLOCK = 64;
+        uint64_t bits[BLOCK];
+        T vals[BLOCK];
+        while (n > 0)
+        {
+          const size_t count = n < BLOCK ? n : BLOCK;
+          for (size_t i = 0; i < count; ++i)
+            bits[i] = random_uint64();
+          for (size_t i = 0; i < count; ++i)
+            vals[i] = func_(bits[i]);
+          out = std::copy(vals, vals + count, out);
+          n -= count;
+        }
+        return out;
+      }
+    };
+
+    template <class T, class Func>
+    auto make_bits_gen(Func func)
+    {
+      return make_gen_from(BitsGen<T, Func>(func));
+    }
+
+    // Uniform [0, 1) from the top mantissa-width bits of a draw; every
+    // result is a multiple of 2^-53 (2^-24 for float).
+    template <class Real>
+    Real unit_real(uint64_t bits)
+    {
+      if constexpr (std::is_same<Real, float>::value)
+        return static_cast<float>(bits >> 40) * 0x1.0p-24f;
+      else
+        return static_cast<Real>(static_cast<double>(bits >> 11) * 0x1.0p-53);
+    }
+
+  } // namespace detail
+
+  // Uniform in [0, 1).
+  template <class Real>
+  auto make_unit_gen()
+  {
+    static_assert(std::is_floating_point<Real>::value, "Real must be a floating point type");
+    return detail::make_bits_gen<Real>([](uint64_t bits) {
+      return detail::unit_real<Real>(bits);
+    });
+  }
+
+  // Uniform in [lo, hi). Results that round up to hi are clamped to
+  // the largest value below it without a branch.
+  template <class Real>
+  auto make_uniform_real_gen(Real lo, Real hi)
+  {
+    static_assert(std::is_floating_point<Real>::value, "Real must be a floating point type");
+    if (!(lo < hi))
+      throw std::invalid_argument("uniform_real: lo must be less than hi");
+
+    // hi - lo overflows for ranges such as [-max, max); then the
+    // offset is added in two halves of (hi / 2 - lo / 2) * u instead
+    const bool halved = std::isinf(hi - lo);
+    const Real width = halved ? hi / 2 - lo / 2 : hi - lo;
+    const Real below_hi = std::nextafter(hi, lo);
+    return detail::make_bits_gen<Real>([lo, width, halved, below_hi](uint64_t bits) {
+      const Real offset = width * detail::unit_real<Real>(bits);
+      const Real val = halved ? lo + offset + offset : lo + offset;
+      return std::max(lo, std::min(val, below_hi));
+    });
+  }
+
+  // Every bit pattern is equally likely, including negative zero,
+  // subnormals, infinities and NaNs. Meant for fuzzing numeric code.
+  template <class Real>
+  auto make_float_bits_gen()
+  {
+    static_assert(std::is_same<Real, float>::value || std::is_same<Real, double>::value,
+                  "bit patterns are defined for float and double");
+    return detail::make_bits_gen<Real>([](uint64_t bits) {
+      Real val;
+      std::memcpy(&val, &bits, sizeof(Real));
+      return val;
+    });
+  }
+
+  // Log-uniform in [lo, hi) for 0 < lo < hi: every decade (or any
+  // other ratio) is equally likely.
+  template <class Real>
+  auto make_log_uniform_gen(Real lo, Real hi)
+  {
+    static_assert(std::is_floating_point<Real>::value, "Real must be a floating point type");
+    if (!(0 < lo && lo < hi))
+      throw std::invalid_argument("log_uniform: requires 0 < lo < hi");
+
+    const Real log_lo = std::log(lo);
+    const Real log_width = std::log(hi) - log_lo;
+    const Real below_hi = std::nextafter(hi, lo);
+    // exp(log(lo)) may round below lo
+    return detail::make_bits_gen<Real>([lo, log_lo, log_width, below_hi](uint64_t bits) {
+      const Real val = std::exp(log_lo + log_width * detail::unit_real<Real>(bits));
+      return std::max(lo, std::min(val, below_hi));
+    });
+  }
+
+  namespace detail {
+
+    // Draws characters uniformly from a fixed character set. Each
+    // 64-bit draw is split into bytes that index a 256-entry table
+    // holding the set repeated floor(256 / size) times; bytes past the
+    // last full repetition are rejected. Sets whose size divides 16
+    // (e.g., hex digits) use 4-bit indices instead, 16 characters per
+    // draw, with an SSSE3 shuffle in generate_n when available.
+    class CharsetGen
+    {
+      std::array<char, 256> table_;
+      unsigned size_;
+      unsigned limit_;
+      bool nibbles_;
+      uint64_t bits_;
+      unsigned avail_;
+
+      template <class OutIter>
+      OutIter generate_nibbles(OutIter out, size_t n)
+      {
+#ifdef __SSSE3__
+        if constexpr (std::is_same<OutIter, char *>::value)
+        {
+          const __m128i lut = _mm_loadu_si128(reinterpret_cast<const __m128i *>(table_.data()));
+          const __m128i mask = _mm_set1_epi8(0x0f);
+          for (; n >= 16; n -= 16, out += 16)
+          {
+            __m128i bytes = _mm_cvtsi64_si128(static_cast<long long>(random_uint64()));
+            __m128i lo = _mm_and_si128(bytes, mask);
+            __m128i hi = _mm_and_si128(_mm_srli_epi16(bytes, 4), mask);
+            __m128i idx = _mm_unpacklo_epi8(lo, hi);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_shuffle_epi8(lut, idx));
+          }
+        }
+#endif // __SSSE3__
+        while (n > 0)
+        {
+          uint64_t bits = random_uint64();
+          for (int i = 0; i < 16 && n > 0; ++i, --n, bits >>= 4)
+            *out++ = table_[bits & 0xf];
+        }
+        return out;
+      }
+
+    public:
+
+      // the saved bits are only a cache of the engine
+      static constexpr bool has_position = false;
+
+      explicit CharsetGen(const std::string & charset)
+        : table_(),
+          size_(static_cast<unsigned>(charset.size())),
+          limit_(0),
+          nibbles_(false),
+          bits_(0),
+          avail_(0)
+      {
+        const size_t size = charset.size();
+        if (size == 0 || size > 256)
+          throw std::invalid_argument("charset: size must be between 1 and 256");
+
+        nibbles_ = (16 % size == 0);
+        limit_ = nibbles_ ? 16 : static_cast<unsigned>(256 / size * size);
+        for (unsigned i = 0; i < limit_; ++i)
+          table_[i] = charset[i % size];
+      }
+
+      char operator()()
+      {
+        // a byte_entropy input is consumed one draw per character and
+        // never cached, so the output depends on the input alone
+        if (active_byte_source())
+          return table_[random_below(size_)];
+
+        const unsigned width = nibbles_ ? 4 : 8;
+        const uint64_t mask = nibbles_ ? 0xf : 0xff;
+        while (true)
+        {
+          if (avail_ == 0)
+          {
+            bits_ = random_uint64();
+            avail_ = 64 / width;
+          }
+
+          unsigned idx = static_cast<unsigned>(bits_ & mask);
+          bits_ >>= width;
+          --avail_;
+          if (idx < limit_)
+            return table_[idx];
+        }
+      }
+
+      size_bounds size_hint() const
+      {
+        return size_bounds::infinite();
+      }
+
+      template <class OutIter>
+      OutIter generate_n(OutIter out, size_t n)
+      {
+        if (active_byte_source())
+        {
+          for (; n > 0; --n)
+            *out++ = table_[random_below(size_)];
+          return out;
+        }
+        if (nibbles_)
+          return generate_nibbles(out, n);
+
+        while (n > 0)
+        {
+          uint64_t bits = random_uint64();
+          for (int i = 0; i < 8 && n > 0; ++i, bits >>= 8)
+          {
+            unsigned idx = static_cast<unsigned>(bits & 0xff);
+            if (idx < limit_)
+            {
+              *out++ = table_[idx];
+              --n;
+            }
+          }
+        }
+        return out;
+      }
+
+      void save(state_writer & writer) const
+      {
+        writer.put(bits_);
+        writer.put(avail_);
+      }
+
+      void load(state_reader & reader)
+      {
+        reader.get(bits_);
+        reader.get(avail_);
+      }
+    };
+
+    std::string char_range(char first, char last)
+    {
+      std::string chars;
+      for (int ch = first; ch <= last; ++ch)
+        chars.push_back(static_cast<char>(ch));
+
+      return chars;
+    }
+
+  } // namespace detail
+
+  auto make_charset_gen(const std::string & charset)
+  {
+    return make_gen_from(detail::CharsetGen(charset));
+  }
+
+  auto make_printable_gen()
+  {
+    return make_charset_gen(detail::char_range(' ', '~'));
+  }
+
+  auto make_ascii_gen()
+  {
+    return make_charset_gen(detail::char_range(0, 127));
+  }
+
+  auto make_lowercase_gen()
+  {
+    return make_charset_gen(detail::char_range('a', 'z'));
+  }
+
+  auto make_uppercase_gen()
+  {
+    return make_charset_gen(detail::char_range('A', 'Z'));
+  }
+
+  auto make_alpha_gen()
+  {
+    return make_charset_gen(detail::char_range('a', 'z') +
+                            detail::char_range('A', 'Z'));
+  }
+
+  auto make_digit_gen()
+  {
+    return make_charset_gen(detail::char_range('0', '9'));
+  }
+
+  auto make_hex_gen()
+  {
+    return make_charset_gen("0123456789abcdef");
+  }
+
+  auto make_alphanum_gen()
+  {
+    return make_charset_gen(detail::char_range('a', 'z') +
+                            detail::char_range('A', 'Z') +
+                            detail::char_range('0', '9'));
+  }
+
+  template <class CharGen>
+  auto make_string_gen(CharGen&& chargen = make_printable_gen(), 
+                       unsigned int maxlen = DEFAULT_MAX_STR_LEN, 
+                       bool possibly_empty = false)
+  {
+    return detail::make_nested_gen<std::string>(
+      [maxlen, possibly_empty](std::string & str, auto & chargen) {
+        int length =
+          possibly_empty ? random_below(maxlen + 1) :
+                           random_below(maxlen) + 1;
+        str.resize(length);
+        chargen.generate_n(&str[0], length);
+    }, std::forward<CharGen>(chargen));
+  }
+
+  template <template <class, class> class Container, class ElemGen>
+  auto make_seq_gen(ElemGen&& elemgen, 
+                    unsigned int maxlen = DEFAULT_MAX_SEQ_LEN,
+                    bool possibly_empty = false)
+  {
+    typedef typename std::remove_reference<ElemGen>::type ElemGenT;
+    typedef typename ElemGenT::value_type ElemType;
+    typedef Container<ElemType, std::allocator<ElemType>> ContainerType;
+
+    return detail::make_nested_gen<ContainerType>(
+      [maxlen, possibly_empty](ContainerType & container, auto & elemgen)
+    {
+      int length =
+        possibly_empty ? random_below(maxlen + 1) :
+                         random_below(maxlen) + 1;
+      // an element source that runs out ends the sequence generator
+      // with out_of_range rather than shortening the container
+      if constexpr (detail::is_fillable_in_place<ContainerType>::value)
+      {
+        // resize keeps the existing elements (and their capacity)
+        // alive so that they can be regenerated in place
+        container.resize(length);
+        for (auto & elem : container)
+          elemgen.generate_into(elem);
+      }
+      else
+      {
+        container.clear();
+        if constexpr (detail::has_reserve<ContainerType>::value)
+          container.reserve(length);
+        for (int i = 0; i < length; ++i)
+          container.push_back(elemgen.generate());
+      }
+    }, std::forward<ElemGen>(elemgen));
+  }
+
+  namespace detail {
+
+    struct TupleZipper
+    {
+      template <class... Args>
+      auto operator()(Args&&... args) const
+      {
+        return std::make_tuple(std::forward<Args>(args)...);
+      }
+    };
+
+    // Calls func on the field generators in order and combines the
+    // results. columns() lets every field generator fill its own
+    // contiguous column instead, and batch() zips the columns into
+    // records afterwards.
+    template <class Zipper, class... GenList>
+    class ZipGen
+    {
+      std::tuple<GenList...> genlist_;
+      Zipper func_;
+
+      template <size_t... I>
+      auto columns_impl(size_t n, std::index_sequence<I...>)
+      {
+        // braced initialization fills the columns left to right
+        return std::tuple<std::vector<typename GenList::value_type>...> {
+          std::get<I>(genlist_).generate_batch(n)...
+        };
+      }
+
+      template <class Columns, size_t... I>
+      auto transpose(Columns & cols, size_t n, std::index_sequence<I...>)
+      {
+        std::vector<decltype(func_(std::move(std::get<I>(cols)[0])...))> records;
+        records.reserve(n);
+        for (size_t row = 0; row < n; ++row)
+          records.push_back(func_(std::move(std::get<I>(cols)[row])...));
+
+        return records;
+      }
+
+      template <class Tuple, size_t... I>
+      void generate_into_impl(Tuple & out, std::index_sequence<I...>)
+      {
+        (std::get<I>(genlist_).generate_into(std::get<I>(out)), ...);
+      }
+
+    public:
+
+      static constexpr bool has_position = (GenList::has_position || ...);
+
+      template <class Z, class... G>
+      explicit ZipGen(Z&& func, G&&... genlist)
+        : genlist_(std::forward<G>(genlist)...),
+          func_(std::forward<Z>(func))
+      { }
+
+      auto operator()()
+      {
+        // braced initialization generates the fields left to right, as
+        // generate_into and columns do, before func combines them
+        return std::apply(func_, std::apply([](auto &... gen) {
+          return std::tuple<typename GenList::value_type...> { gen.generate()... };
+        }, genlist_));
+      }
+
+      void skip(size_t count)
+      {
+        std::apply([count](auto &... gen) { (gen.skip(count), ...); }, genlist_);
+      }
+
+      size_bounds size_hint() const
+      {
+        return std::apply([](const auto &... gen) {
+          size_bounds hint = size_bounds::infinite();
+          ((hint = min_bounds(hint, gen.size_hint())), ...);
+          return hint;
+        }, genlist_);
+      }
+
+      template <class Tuple>
+      void generate_into(Tuple & out)
+      {
+        if constexpr (std::is_same<Zipper, TupleZipper>::value)
+          generate_into_impl(out, std::index_sequence_for<GenList...>());
+        else
+          out = (*this)();
+      }
+
+      auto columns(size_t n)
+      {
+        return columns_impl(n, std::index_sequence_for<GenList...>());
+      }
+
+      auto batch(size_t n)
+      {
+        auto cols = columns(n);
+        return transpose(cols, n, std::index_sequence_for<GenList...>());
+      }
+
+      void save(state_writer & writer) const
+      {
+        std::apply([&writer](const auto &... gen) {
+          (gen.save(writer), ...);
+        }, genlist_);
+      }
+
+      void load(state_reader & reader)
+      {
+        std::apply([&reader](auto &... gen) {
+          (gen.load(reader), ...);
+        }, genlist_);
+      }
+    };
+
+  } // namespace detail
+
+  template <class Zipper, class... GenList>
+  auto make_zip_gen(Zipper&& func, GenList&&... genlist)
+  {
+    return make_gen_from(
+      detail::ZipGen<std::decay_t<Zipper>, std::decay_t<GenList>...>(
+        std::forward<Zipper>(func), std::forward<GenList>(genlist)...));
+  }
+
+  template <class T, class GenFunc>
+  template <class Zipper, class... GenList>
+  auto Gen<T, GenFunc>::zip_with(Zipper&& func, GenList&&... genlist)
+  {
+    return make_zip_gen(std::forward<Zipper>(func),
+                        std::move(*this),
+                        std::forward<GenList>(genlist)...);
+  }
+
+  template<size_t... Dims>
+  struct dim_list {
+    enum { size = sizeof...(Dims) };
+  };
+
+  namespace detail {
+
+    template <class ElemGen, size_t DimListSize, class DimList>
+    struct ArrayGen;
+
+    template <class ElemGen, size_t DimListSize, size_t Head, size_t... Tail>
+    struct ArrayGen<ElemGen, DimListSize, dim_list<Head, Tail...>>
+    {
+      static constexpr auto make(ElemGen && elemgen)
+      {
+        auto innergen =
+          ArrayGen<ElemGen, DimListSize - 1, dim_list<Tail...>>::make(std::move(elemgen));
+        
+        typedef typename decltype(innergen)::value_type InnerType;
+        return make_nested_gen<std::array<InnerType, Head>>(
+          [](auto & arr, auto & innergen) {
+            for (auto & elem : arr)
+              innergen.generate_into(elem);
+        }, std::move(innergen));
+      }
+    };
+    
+    template <class ElemGen, size_t Dim>
+    struct ArrayGen<ElemGen, 1, dim_list<Dim>>
+    {
+      static constexpr auto make(ElemGen && elemgen)
+      {
+        return make_nested_gen<std::array<typename ElemGen::value_type, Dim>>(
+          [](auto & arr, auto & elemgen) {
+            for (auto & elem : arr)
+              elemgen.generate_into(elem);
+        }, std::move(elemgen));
+      }
+    };
+
+    template <class... Args>
+    struct TupleGen;
+
+    template <class... Args>
+    struct TupleGen<std::tuple<Args...>>
+    {
+      static auto make()
+      {
+        return make_zip_gen(TupleZipper(), GenFactory<Args>::make()...);
+      }
+    };
+
+  } // anonymous namespace
+
+  template <class ElemGen, class DimList>
+  constexpr auto make_array_gen(ElemGen&& elemgen, DimList)
+  {
+    // an rvalue element generator is moved all the way to the
+    // innermost level; an lvalue is copied once
+    typedef std::decay_t<ElemGen> ElemGenT;
+    return detail::ArrayGen<ElemGenT, DimList::size, DimList>::make(
+      ElemGenT(std::forward<ElemGen>(elemgen)));
+  }
+
+  template <class ElemGen>
+  auto make_optional_gen(ElemGen&& elemgen)
+  {
+    typedef typename std::remove_reference<ElemGen>::type ElemGenT;
+    typedef typename boost::optional<typename ElemGenT::value_type> Opt;
+
+    return detail::make_nested_gen<Opt>([](Opt & opt, auto & elemgen) {
+      if (random_below(2))
+        opt = boost::none;
+      else if (opt)
+        elemgen.generate_into(*opt);
+      else
+        opt = elemgen.generate();
+    }, std::forward<ElemGen>(elemgen));
+  }
+
+  namespace detail {
+
+    template <class T>
+    class InorderGen
+    {
+      std::vector<T> range_;
+      size_t i_;
+
+    public:
+
+      explicit InorderGen(std::vector<T> range)
+        : range_(std::move(range)),
+          i_(0)
+      { }
+
+      T operator()()
+      {
+        if(i_ < range_.size())
+          return range_[i_++];
+        else
+          throw std::out_of_range("in_order_gen: Range traversal completed!");
+      }
+
+      void skip(size_t count)
+      {
+        if(count > range_.size() - i_)
+        {
+          i_ = range_.size();
+          throw std::out_of_range("in_order_gen: Range traversal completed!");
+        }
+        i_ += count;
+      }
+
+      size_bounds size_hint() const
+      {
+        return size_bounds::exact(range_.size() - i_);
+      }
+
+      void save(state_writer & writer) const
+      {
+        writer.put(static_cast<uint64_t>(i_));
+      }
+
+      void load(state_reader & reader)
+      {
+        uint64_t i;
+        reader.get(i);
+        i_ = static_cast<size_t>(i);
+      }
+    };
+
+  } // namespace detail
+
+  template <class Iter>
+  auto make_inorder_gen(Iter begin, Iter end)
+  {
+    std::vector<typename std::iterator_traits<Iter>::value_type> 
+      range(begin, end);
+    
+    return make_gen_from(detail::InorderGen<
+      typename std::iterator_traits<Iter>::value_type>(std::move(range)));
+  }
+
+  template <class T>
+  auto make_inorder_gen(std::initializer_list<T> list)
+  {
+    return make_inorder_gen(list.begin(), list.end());
+  }
+
+  template <class T>
+  auto make_oneof_gen(std::initializer_list<T> list)
+  {
+    std::vector<T> options(list);
+    return make_gen_from([options = std::move(options)]() {
+      return *(options.begin() + random_below(options.size()));
+    });
+  }
+
+  template <class T>
+  auto make_oneof_gen(std::vector<T> options)
+  {
+    return make_gen_from([options = std::move(options)]() {
+      return *(options.begin() + random_below(options.size()));
     });
   }
 
-  template <class CharGen>
-  auto make_string_gen(CharGen&& chargen = make_printable_gen(), 
-                       unsigned int maxlen = DEFAULT_MAX_STR_LEN, 
-                       bool possibly_empty = false)
+  namespace detail {
+
+    // Weighted choice among generators of different types with the
+    // same value type. One alias-table draw picks the branch, and the
+    // branch is called through an if-chain over the tuple index that
+    // the compiler resolves statically. generate_n draws the choices of
+    // a whole block first, lets every branch fill its share with its own
+    // generate_n, and then interleaves the values in the drawn order.
+    template <class... GenList>
+    class FrequencyGen
+    {
+      typedef typename std::tuple_element<0, std::tuple<GenList...>>::type::value_type T;
+      static constexpr size_t N = sizeof...(GenList);
+
+      std::tuple<GenList...> genlist_;
+      alias_table table_;
+      std::array<std::vector<T>, N> scratch_;
+
+      template <size_t I = 0>
+      T dispatch(uint32_t branch)
+      {
+        if constexpr (I + 1 == N)
+          return std::get<I>(genlist_).generate();
+        else
+          return branch == I ? std::get<I>(genlist_).generate() : dispatch<I + 1>(branch);
+      }
+
+      template <size_t... I>
+      void fill_branches(const std::array<size_t, N> & counts, std::index_sequence<I...>)
+      {
+        ((scratch_[I].resize(counts[I]),
+          std::get<I>(genlist_).generate_n(scratch_[I].begin(), counts[I])), ...);
+      }
+
+    public:
+
+      static_assert(std::conjunction<std::is_same<T, typename GenList::value_type>...>::value,
+                    "frequency_gen: all generators must have the same value type");
+
+      static constexpr bool has_position = (GenList::has_position || ...);
+
+      template <class... Gens>
+      FrequencyGen(const std::vector<double> & weights, Gens&&... gens)
+        : genlist_(std::forward<Gens>(gens)...),
+          table_(weights)
+      { }
+
+      T operator()()
+      {
+        return dispatch(table_(random_uint64()));
+      }
+
+      template <class OutIter>
+      OutIter generate_n(OutIter out, size_t n)
+      {
+        constexpr size_t BLOCK = 256;
+        uint32_t branches[BLOCK];
+        while (n > 0)
+        {
+          const size_t count = n < BLOCK ? n : BLOCK;
+          std::array<size_t, N> counts {};
+          for (size_t i = 0; i < count; ++i)
+            ++counts[branches[i] = table_(random_uint64())];
+
+          fill_branches(counts, std::index_sequence_for<GenList...>());
+          std::array<size_t, N> next {};
+          for (size_t i = 0; i < count; ++i, ++out)
+            *out = std::move(scratch_[branches[i]][next[branches[i]]++]);
+          n -= count;
+        }
+        return out;
+      }
+
+      size_bounds size_hint() const
+      {
+        return std::apply([](const auto &... gens) {
+          size_t upper = 0;
+          ((upper = saturating_add(upper, gens.size_hint().upper)), ...);
+          return size_bounds { std::min({ gens.size_hint().lower... }), upper };
+        }, genlist_);
+      }
+
+      void save(state_writer & writer) const
+      {
+        std::apply([&writer](const auto &... gens) { (gens.save(writer), ...); }, genlist_);
+      }
+
+      void load(state_reader & reader)
+      {
+        std::apply([&reader](auto &... gens) { (gens.load(reader), ...); }, genlist_);
+      }
+    };
+
+  } // namespace detail
+
+  // make_frequency_gen(std::make_pair(3, digits), std::make_pair(1, letters))
+  // draws from digits three times as often as from letters.
+  template <class... Weighted>
+  auto make_frequency_gen(Weighted&&... choices)
   {
+    static_assert(sizeof...(Weighted) > 0, "frequency_gen: no generators");
+    const std::vector<double> weights { static_cast<double>(choices.first)... };
     return make_gen_from(
-      [chargen=std::forward<CharGen>(chargen),
-       maxlen,
-       possibly_empty]() mutable {
-        std::string str;
-        int length =
-          possibly_empty ? (random_int32() % (maxlen+1)) :
-                           (random_int32() % maxlen) + 1;
-        str.reserve(length);
-        for (int i = 0; i < length; ++i)
-          str.push_back(chargen.generate());
-        
-        return str;
-    });
+      detail::FrequencyGen<std::decay_t<decltype(choices.second)>...>(
+        weights, std::forward<Weighted>(choices).second...));
   }
 
-  template <template <class, class> class Container, class ElemGen>
-  auto make_seq_gen(ElemGen&& elemgen, 
-                    unsigned int maxlen = DEFAULT_MAX_SEQ_LEN,
-                    bool possibly_empty = false)
+  // Immutable set of strings interned in one contiguous buffer.
+  // Generators built from a vocabulary share it instead of copying it.
+  class vocabulary
   {
-    return make_gen_from([elemgen=std::forward<ElemGen>(elemgen),
-                          maxlen,
-                          possibly_empty]() mutable 
-    {
-      typedef typename std::remove_reference<ElemGen>::type ElemGenT;
-      typedef typename ElemGenT::value_type ElemType;
-      Container<ElemType, std::allocator<ElemType>> container;
+    std::string chars_;
+    std::vector<uint32_t> offsets_;
 
-      int length =
-        possibly_empty ? (random_int32() % (maxlen + 1)) :
-                         (random_int32() % maxlen) + 1;
-      container.reserve(length);
-      for (int i = 0; i < length; ++i)
-        container.push_back(elemgen.generate());
+  public:
 
-      return container;
-    });
-  }
+    template <class StringList>
+    explicit vocabulary(const StringList & words)
+      : offsets_(1, 0)
+    {
+      for (const auto & word : words)
+      {
+        chars_.append(word);
+        if (chars_.size() > std::numeric_limits<uint32_t>::max())
+          throw std::length_error("vocabulary: more than 4GB of text");
+        offsets_.push_back(static_cast<uint32_t>(chars_.size()));
+      }
+      if (size() == 0)
+        throw std::invalid_argument("vocabulary: no entries");
+    }
 
-  template <class Zipper, class... GenList>
-  auto make_zip_gen(Zipper&& func, GenList&&... genlist)
-  {
-    return make_gen_from(
-      [genlist...,
-       func = std::forward<Zipper>(func)]() mutable {
-          return func(genlist.generate()...);
-    });
-  }
+    vocabulary(std::initializer_list<const char *> words)
+      : vocabulary(std::vector<std::string>(words.begin(), words.end()))
+    { }
 
-  template<size_t... Dims>
-  struct dim_list {
-    enum { size = sizeof...(Dims) };
+    uint32_t size() const
+    {
+      return static_cast<uint32_t>(offsets_.size() - 1);
+    }
+
+    std::string_view operator [] (uint32_t i) const
+    {
+      return std::string_view(chars_.data() + offsets_[i],
+                              offsets_[i + 1] - offsets_[i]);
+    }
   };
 
   namespace detail {
 
-    template <class ElemGen, size_t DimListSize, class DimList>
-    struct ArrayGen;
-
-    template <class ElemGen, size_t DimListSize, size_t Head, size_t... Tail>
-    struct ArrayGen<ElemGen, DimListSize, dim_list<Head, Tail...>>
+    // Uniform index below size from 32 random bits by multiply-shift,
+    // two indices per 64-bit draw in generate_n.
+    class VocabIndexGen
     {
-      static auto make(ElemGen & elemgen)
-      {
-        auto innergen =
-          ArrayGen<ElemGen, DimListSize - 1, dim_list<Tail...>>::make(elemgen);
-        
-        return make_gen_from([innergen=std::move(innergen)]() mutable {
+      uint64_t size_;
 
-          std::array<decltype(innergen.generate()), Head> arr;
-          for (auto & elem : arr)
-            elem = innergen.generate();
+    public:
 
-          return arr;
-        });
-      }
-    };
-    
-    template <class ElemGen, size_t Dim>
-    struct ArrayGen<ElemGen, 1, dim_list<Dim>>
-    {
-      static auto make(ElemGen & elemgen)
-      {
-        return make_gen_from([elemgen]() mutable {
-          typedef typename std::remove_reference<ElemGen>::type ElemGenT;
-          std::array<typename ElemGenT::value_type, Dim> arr;
-          for (auto & elem : arr)
-            elem = elemgen.generate();
+      explicit VocabIndexGen(uint32_t size)
+        : size_(size)
+      { }
 
-          return arr;
-        });
+      uint32_t operator()()
+      {
+        return static_cast<uint32_t>(((random_uint64() >> 32) * size_) >> 32);
       }
-    };
 
-    template <class... Args>
-    struct TupleGen;
+      template <class OutIter>
+      OutIter generate_n(OutIter out, size_t n)
+      {
+        for (; n >= 2; n -= 2)
+        {
+          const uint64_t bits = random_uint64();
+          *out++ = static_cast<uint32_t>(((bits >> 32) * size_) >> 32);
+          *out++ = static_cast<uint32_t>(((bits & 0xffffffff) * size_) >> 32);
+        }
+        if (n)
+          *out++ = (*this)();
+        return out;
+      }
 
-    template <class... Args>
-    struct TupleGen<std::tuple<Args...>>
-    {
-      static auto make()
+      size_bounds size_hint() const
       {
-        return make_zip_gen([](auto&&... args) {
-          return std::make_tuple(std::forward<decltype(args)>(args)...);
-        }, GenFactory<Args>::make()...);
+        return size_bounds::infinite();
       }
     };
 
-  } // anonymous namespace
+  } // namespace detail
 
-  template <class ElemGen, class DimList>
-  auto make_array_gen(ElemGen&& elemgen, DimList)
+  // Uniformly chosen indices into vocab; generate_n emits them in
+  // bulk, e.g. for a dictionary-encoded column.
+  auto make_vocab_index_gen(const vocabulary & vocab)
   {
-    typedef typename std::remove_reference<ElemGen>::type ElemGenT;
-    return detail::ArrayGen<ElemGenT, DimList::size, DimList>::make(elemgen);
+    return make_gen_from(detail::VocabIndexGen(vocab.size()));
   }
 
-  template <class ElemGen>
-  auto make_optional_gen(ElemGen&& elemgen)
+  // Uniformly chosen entries of vocab as std::string_view. No string
+  // is copied or allocated; the views stay valid as long as any
+  // generator built from the vocabulary is alive.
+  auto make_vocab_gen(std::shared_ptr<const vocabulary> vocab)
   {
-    typedef typename std::remove_reference<ElemGen>::type ElemGenT;
-    typedef typename boost::optional<typename ElemGenT::value_type> Opt;
-
-    return make_gen_from([elemgen=std::forward<ElemGen>(elemgen)]() mutable {
-      return (random_int32() % 2) ? Opt() : Opt(elemgen.generate());
+    auto indexgen = make_vocab_index_gen(*vocab);
+    return std::move(indexgen).map([vocab = std::move(vocab)](uint32_t i) {
+      return (*vocab)[i];
     });
   }
 
-  template <class Iter>
-  auto make_inorder_gen(Iter begin, Iter end)
+  auto make_vocab_gen(const std::vector<std::string> & words)
   {
-    std::vector<typename std::iterator_traits<Iter>::value_type> 
-      range(begin, end);
-    
-    /*
-    auto iter = range.begin();
-    return make_gen_from(
-        [range = std::move(range),
-         iter = std::move(iter)]() mutable {
-           if(iter != range.end())
-             return *iter++;
-           else
-             throw std::out_of_range("in_order_gen: Range traversal completed!");
-    });*/
-    return make_gen_from(
-        [range = std::move(range),
-         i = 0u]() mutable {
-           if(i < range.size())
-             return range[i++];
-           else
-             throw std::out_of_range("in_order_gen: Range traversal completed!");
-    });
+    return make_vocab_gen(std::make_shared<const vocabulary>(words));
   }
 
+  // Like make_oneof_gen but yields references to the shared options
+  // instead of copies. The values are std::reference_wrapper<const T>
+  // (a plain const T & cannot be stored in buffers or vectors) and
+  // convert to const T &; they stay valid while any copy of the
+  // generator is alive.
   template <class T>
-  auto make_inorder_gen(std::initializer_list<T> list)
+  auto make_oneof_ref_gen(std::vector<T> options)
   {
-    return make_inorder_gen(list.begin(), list.end());
+    if (options.empty())
+      throw std::invalid_argument("oneof_ref: no options");
+    auto shared = std::make_shared<const std::vector<T>>(std::move(options));
+    auto indexgen = make_gen_from(detail::VocabIndexGen(
+                      static_cast<uint32_t>(shared->size())));
+    return std::move(indexgen).map([shared = std::move(shared)](uint32_t i) {
+      return std::cref((*shared)[i]);
+    });
   }
 
-  template <class T>
-  auto make_oneof_gen(std::initializer_list<T> list)
+  namespace detail {
+
+    // Forwards the whole generator protocol to a generator reached
+    // through Ptr (a raw or shared pointer), so composing it copies
+    // only the pointer.
+    template <class TGen, class Ptr>
+    class IndirectGen
+    {
+      Ptr gen_;
+
+    public:
+
+      static constexpr bool has_position = TGen::has_position;
+      static constexpr bool shares_state = true;
+
+      explicit IndirectGen(Ptr gen)
+        : gen_(std::move(gen))
+      { }
+
+      auto operator()()
+      {
+        return gen_->generate();
+      }
+
+      template <class U>
+      void generate_into(U & out)
+      {
+        gen_->generate_into(out);
+      }
+
+      template <class OutIter>
+      OutIter generate_n(OutIter out, size_t n)
+      {
+        return gen_->generate_n(out, n);
+      }
+
+      void skip(size_t count)
+      {
+        gen_->skip(count);
+      }
+
+      size_bounds size_hint() const
+      {
+        return gen_->size_hint();
+      }
+
+      void save(state_writer & writer) const
+      {
+        gen_->save(writer);
+      }
+
+      void load(state_reader & reader)
+      {
+        gen_->load(reader);
+      }
+    };
+
+  } // namespace detail
+
+  // Uses g in place: the returned generator (and every copy of it)
+  // advances g itself, which must outlive them. Lets one large
+  // generator, e.g. one holding a vocabulary or a Markov model, feed
+  // several parts of a pipeline without being copied.
+  //
+  // Borrowed and shared generators are single-threaded. Nothing
+  // synchronizes the copies, so they must not reach parallel_reduce,
+  // check or any other code that copies a generator per thread. Passing
+  // the wrapper itself there fails to compile; a pipeline that only
+  // contains one is not detected.
+  template <class TGen>
+  auto borrow(TGen & g)
   {
-    std::vector<T> options(list);
-    return make_gen_from([options = std::move(options)]() {
-      return *(options.begin() + random_int32() % options.size());
-    });
+    return make_gen_from(detail::IndirectGen<TGen, TGen *>(&g));
   }
 
-  template <class T>
-  auto make_oneof_gen(std::vector<T> options)
+  // Moves g to the heap; the returned generator and all its copies
+  // share that one instance and its state. Single-threaded, as for
+  // borrow.
+  template <class TGen>
+  auto share(TGen && g)
   {
-    return make_gen_from([options = std::move(options)]() {
-      return *(options.begin() + random_int32() % options.size());
-    });
+    static_assert(!std::is_lvalue_reference<TGen>::value,
+                  "share takes ownership; use borrow for an lvalue");
+    return make_gen_from(detail::IndirectGen<TGen, std::shared_ptr<TGen>>(
+      std::make_shared<TGen>(std::move(g))));
   }
 
   template <class UGen, class VGen>
   auto make_pair_gen(UGen&& ugen, VGen&& vgen)
   {
-    return make_gen_from(
-      [ugen = std::forward<UGen>(ugen),
-       vgen = std::forward<VGen>(vgen)]() mutable {
-          return std::make_pair(ugen.generate(), vgen.generate());
-    });
+    typedef typename std::remove_reference<UGen>::type::value_type U;
+    typedef typename std::remove_reference<VGen>::type::value_type V;
+
+    return detail::make_nested_gen<std::pair<U, V>>(
+      [](std::pair<U, V> & pair, auto & ugen, auto & vgen) {
+          ugen.generate_into(pair.first);
+          vgen.generate_into(pair.second);
+    }, std::forward<UGen>(ugen), std::forward<VGen>(vgen));
   }
 
   template <class... GenList>
   auto make_composed_gen(GenList&&... genlist)
   {
-    return make_gen_from(
-      [genlist...]() mutable {
-      return std::make_tuple(genlist.generate()...);
-    });
+    return make_zip_gen(detail::TupleZipper(),
+                        std::forward<GenList>(genlist)...);
   }
 
   template <class Tuple>
@@ -569,67 +2764,357 @@ namespace gen {
     return detail::TupleGen<Tuple>::make();
   }
 
-  auto make_stepper_gen(int start = 0, 
+  namespace detail {
+
+    class StepperGen
+    {
+      int start_, max_, step_;
+      bool cycle_;
+      int current_;
+      bool init_;
+      bool empty_;
+
+    public:
+
+      constexpr StepperGen(int start, int max, int step, bool cycle)
+        : start_(start),
+          max_(max),
+          step_(step),
+          cycle_(cycle),
+          current_(start),
+          init_(false),
+          empty_(step >= 0 ? start > max : start < max)
+      { }
+
+      constexpr int operator()()
+      {
+        if(empty_)
+          throw std::out_of_range("stepper: steps over!");
+
+        if(init_==false)
+          init_ = true;
+        else
+        {
+          if(step_ >= 0)
+          {
+            if(current_ + step_ <= max_)
+              current_ = current_ + step_;
+            else
+            {
+              if(cycle_)
+                current_ = start_;
+              else
+                throw std::out_of_range("stepper: steps over!");
+            }
+          }
+          else
+          {
+            if(current_ + step_ >= max_)
+              current_ = current_ + step_;
+            else
+            {
+              if(cycle_)
+                current_ = start_;
+              else
+                throw std::out_of_range("stepper: steps over!");
+            }
+          }
+        }
+
+        return current_;
+      }
+
+      // Jumps to the value count steps ahead in O(1).
+      void skip(size_t count)
+      {
+        if(count == 0)
+          return;
+        if(empty_)
+          throw std::out_of_range("stepper: steps over!");
+
+        // number of values generated so far and after the jump
+        const uint64_t done = init_ ? static_cast<uint64_t>(
+          (static_cast<int64_t>(current_) - start_) / (step_ ? step_ : 1)) + 1 : 0;
+        uint64_t index = done + count - 1;
+
+        if(step_ != 0)
+        {
+          const uint64_t period = static_cast<uint64_t>(
+            (static_cast<int64_t>(max_) - start_) / step_) + 1;
+          if(index >= period)
+          {
+            if(!cycle_)
+            {
+              current_ = static_cast<int>(start_ + static_cast<int64_t>(period - 1) * step_);
+              init_ = true;
+              throw std::out_of_range("stepper: steps over!");
+            }
+            index %= period;
+          }
+          current_ = static_cast<int>(start_ + static_cast<int64_t>(index) * step_);
+        }
+        init_ = true;
+      }
+
+      size_bounds size_hint() const
+      {
+        if(empty_)
+          return size_bounds::exact(0);
+        if(cycle_ || step_ == 0)
+          return size_bounds::infinite();
+
+        const uint64_t period = static_cast<uint64_t>(
+          (static_cast<int64_t>(max_) - start_) / step_) + 1;
+        const uint64_t done = init_ ? static_cast<uint64_t>(
+          (static_cast<int64_t>(current_) - start_) / step_) + 1 : 0;
+        return size_bounds::exact(static_cast<size_t>(period - done));
+      }
+
+      void save(state_writer & writer) const
+      {
+        writer.put(current_);
+        writer.put(init_);
+      }
+
+      void load(state_reader & reader)
+      {
+        reader.get(current_);
+        reader.get(init_);
+      }
+    };
+
+  } // namespace detail
+
+  constexpr auto make_stepper_gen(int start = 0, 
                         int max = std::numeric_limits<int>::max(), 
                         int step = 1, 
                         bool cycle = false)
   {
-    bool empty = false;
-    if(step >= 0)
-    {
-      if(start > max)
-        empty = true;
-    }
-    else
-    {
-      if(start < max)
-        empty = true;
-    }
-
-    auto current = start;
-    auto init = false;
-
-    return make_gen_from([start, max, step, cycle, current, init, empty]() mutable 
-           {
-               if(empty)
-                 throw std::out_of_range("stepper: steps over!");
-
-               if(init==false)
-                 init = true;
-               else
-               {
-                 if(step >= 0)
-                 {
-                   if(current + step <= max)
-                      current = current + step;
-                   else
-                   {
-                     if(cycle)
-                       current = start;
-                     else
-                       throw std::out_of_range("stepper: steps over!");
-                   }
-                 }
-                 else
-                 {
-                   if(current + step >= max)
-                      current = current + step;
-                   else
-                   {
-                     if(cycle)
-                       current = start;
-                     else
-                       throw std::out_of_range("stepper: stpes over!");
-                   }
-                 }
-               }
-               
-               return current;
-           });
+    return make_gen_from(detail::StepperGen(start, max, step, cycle));
+  }
+
+  namespace detail {
+
+    // Binomial(n, p) from a private engine, so that independent callers
+    // holding the same seed agree on the result. Small means are drawn
+    // exactly by inversion; large ones use the normal approximation,
+    // whose error is negligible at that size.
+    uint64_t binomial(Engine & engine, uint64_t n, double p)
+    {
+      if (p <= 0 || n == 0)
+        return 0;
+      if (p >= 1)
+        return n;
+      if (p > 0.5)
+        return n - binomial(engine, n, 1 - p);
+
+      const double mean = n * p;
+      if (mean < 30)
+      {
+        const double u = unit_real<double>(engine.next());
+        double prob = std::pow(1 - p, static_cast<double>(n));
+        double cdf = prob;
+        uint64_t x = 0;
+        while (u >= cdf && x < n)
+        {
+          prob *= static_cast<double>(n - x) / (x + 1) * p / (1 - p);
+          cdf += prob;
+          ++x;
+        }
+        return x;
+      }
+
+      const double r = std::sqrt(-2 * std::log1p(-unit_real<double>(engine.next())));
+      const double z = r * std::cos(6.283185307179586 * unit_real<double>(engine.next()));
+      const double x = std::round(mean + std::sqrt(mean * (1 - p)) * z);
+      return x <= 0 ? 0 : x >= n ? n : static_cast<uint64_t>(x);
+    }
+
+    // Ascending uniform order statistics, one per call: the gap above
+    // the previous value shrinks by V^(1/k) for the k values left, so
+    // nothing is stored or sorted. The gap is kept as a logarithm to
+    // keep its precision through billions of values.
+    template <class T>
+    class SortedGen
+    {
+      T lo_, hi_;
+      uint64_t remaining_;
+      double log_gap_;
+
+    public:
+
+      SortedGen(T lo, T hi, uint64_t count)
+        : lo_(lo),
+          hi_(hi),
+          remaining_(count),
+          log_gap_(0)
+      { }
+
+      T operator()()
+      {
+        if (remaining_ == 0)
+          throw std::out_of_range("sorted_gen: all values generated");
+
+        log_gap_ += std::log1p(-unit_real<double>(random_uint64())) / remaining_--;
+        const double u = -std::expm1(log_gap_);
+        if constexpr (std::is_floating_point<T>::value)
+        {
+          // hi - lo may overflow; each half of the offset cannot
+          const T half = static_cast<T>((hi_ / 2 - lo_ / 2) * u);
+          return std::min(static_cast<T>(lo_ + half + half), std::nextafter(hi_, lo_));
+        }
+        else
+        {
+          // the offset from lo may not fit in T, but fits its unsigned
+          // counterpart
+          typedef std::make_unsigned_t<T> U;
+          const U width = static_cast<U>(static_cast<U>(hi_) - static_cast<U>(lo_));
+          const double offset = static_cast<double>(width) * u;
+          const U step = offset >= static_cast<double>(width) ?
+                           static_cast<U>(width - 1) : static_cast<U>(offset);
+          return static_cast<T>(static_cast<U>(static_cast<U>(lo_) + step));
+        }
+      }
+
+      size_bounds size_hint() const
+      {
+        return size_bounds::exact(static_cast<size_t>(remaining_));
+      }
+
+      void save(state_writer & writer) const
+      {
+        writer.put(remaining_);
+        writer.put(log_gap_);
+      }
+
+      void load(state_reader & reader)
+      {
+        reader.get(remaining_);
+        reader.get(log_gap_);
+      }
+    };
+
+    template <class T>
+    T shard_bound(T lo, T hi, unsigned k, unsigned shards)
+    {
+      if (k >= shards)
+        return hi;
+      if constexpr (std::is_floating_point<T>::value)
+      {
+        const T half = (hi / 2 - lo / 2) * k / shards;
+        return lo + half + half;
+      }
+      else
+      {
+        // exact and free of overflow: (width % shards) * k < shards^2
+        typedef std::make_unsigned_t<T> U;
+        const uint64_t width = static_cast<U>(static_cast<U>(hi) - static_cast<U>(lo));
+        const uint64_t offset = width / shards * k + width % shards * k / shards;
+        return static_cast<T>(static_cast<U>(static_cast<U>(lo) + static_cast<U>(offset)));
+      }
+    }
+
+  } // namespace detail
+
+  // n uniform values in [lo, hi) in ascending order, in O(1) time and
+  // memory per value; the sequence is distributed like n uniform draws
+  // that were then sorted. Integer or floating point T.
+  //
+  // For parallel generation, shard k of shards covers the k-th equal
+  // sub-range and gets its share of n from binomial draws seeded with
+  // seed, so shards built independently with the same n and seed have
+  // counts summing to n. Concatenating the shards in order yields
+  // the full sorted sequence.
+  template <class T>
+  auto make_sorted_gen(T lo, T hi, uint64_t n,
+                       unsigned shard = 0, unsigned shards = 1, uint64_t seed = 1)
+  {
+    if (!(lo < hi))
+      throw std::invalid_argument("sorted_gen: lo must be less than hi");
+    if (shard >= shards)
+      throw std::invalid_argument("sorted_gen: shard out of range");
+
+    detail::Engine counts(seed);
+    uint64_t remaining = n, count = 0;
+    for (unsigned k = 0; k <= shard; ++k)
+    {
+      const double below = static_cast<double>(detail::shard_bound(lo, hi, k, shards));
+      const double above = static_cast<double>(detail::shard_bound(lo, hi, k + 1, shards));
+      const double p = (above / 2 - below / 2) / (static_cast<double>(hi) / 2 - below / 2);
+      count = detail::binomial(counts, remaining, p);
+      remaining -= count;
+    }
+    return make_gen_from(detail::SortedGen<T>(
+      detail::shard_bound(lo, hi, shard, shards),
+      detail::shard_bound(lo, hi, shard + 1, shards), count));
   }
 
   namespace detail {
 
+    template <class T, class HeapComp>
+    class PriorityGen
+    {
+      typedef std::priority_queue<T, std::vector<T>, HeapComp> Heap;
+      Heap heap_;
+
+    public:
+
+      explicit PriorityGen(Heap heap)
+        : heap_(std::move(heap))
+      { }
+
+      T operator()()
+      {
+        if (heap_.empty())
+          throw std::out_of_range("empty heap");
+        else
+        {
+          T val = heap_.top();
+          heap_.pop();
+          return val;
+        }
+      }
+
+      void skip(size_t count)
+      {
+        for (; count > 0; --count)
+        {
+          if (heap_.empty())
+            throw std::out_of_range("empty heap");
+          heap_.pop();
+        }
+      }
+
+      size_bounds size_hint() const
+      {
+        return size_bounds::exact(heap_.size());
+      }
+
+      void save(state_writer & writer) const
+      {
+        Heap heap = heap_;
+        writer.put(static_cast<uint64_t>(heap.size()));
+        while (!heap.empty())
+        {
+          writer.put(heap.top());
+          heap.pop();
+        }
+      }
+
+      void load(state_reader & reader)
+      {
+        uint64_t size;
+        reader.get(size);
+        heap_ = Heap();
+        for (uint64_t i = 0; i < size; ++i)
+        {
+          T val;
+          reader.get(val);
+          heap_.push(std::move(val));
+        }
+      }
+    };
+
     template <class Gen, class HeapComp>
     auto make_priority_n_gen(Gen&& src_gen, size_t n, HeapComp comp)
     {
@@ -656,16 +3141,7 @@ namespace gen {
         }
       }
 
-      return make_gen_from([heap = std::move(heap)]() mutable {
-        if (heap.empty())
-          throw std::out_of_range("empty heap");
-        else
-        {
-          SrcType val = heap.top();
-          heap.pop();
-          return val;
-        }
-      });
+      return make_gen_from(PriorityGen<SrcType, HeapComp>(std::move(heap)));
     }
 
   } // namespace detail
@@ -0,0 +1,296 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "generator.h"
+
+// Edge-stream generators for random graphs. Every generator yields
+// edges as std::pair<uint64_t, uint64_t> (source, destination), so the
+// streams compose with map, zip_with, take and the sinks like any
+// other generator.
+
+namespace gen {
+
+  typedef std::pair<uint64_t, uint64_t> edge;
+
+  namespace detail {
+
+    // G(n, p) by geometric skipping (Batagelj & Brandes): the gap to the
+    // next present edge is drawn directly, so the cost is proportional
+    // to the number of edges rather than n^2. Candidate pairs are
+    // enumerated row by row, (v, w) with w < v for undirected graphs
+    // and every w != v for directed ones.
+    class ErdosRenyiGen
+    {
+      uint64_t n_;
+      bool directed_;
+      double log_q_;
+      uint64_t row_end_;
+      uint64_t v_;
+      int64_t w_;
+
+      uint64_t row_length(uint64_t v) const
+      {
+        return directed_ ? n_ : v;
+      }
+
+      // Candidates after the current one, in floating point because
+      // n^2 can exceed any integer type.
+      double remaining() const
+      {
+        const double rows = static_cast<double>(row_end_ - v_);
+        const double total = directed_ ?
+          rows * static_cast<double>(n_) :
+          (static_cast<double>(v_) + static_cast<double>(row_end_ - 1)) * rows / 2;
+        return total - static_cast<double>(w_ + 1);
+      }
+
+    public:
+
+      ErdosRenyiGen(uint64_t n, double p, bool directed,
+                    uint64_t row_begin, uint64_t row_end)
+        : n_(n),
+          directed_(directed),
+          log_q_(p >= 1.0 ? 0.0 : std::log1p(-p)),
+          row_end_(p <= 0.0 ? row_begin : row_end),
+          v_(row_begin),
+          w_(-1)
+      { }
+
+      edge operator()()
+      {
+        while (v_ < row_end_)
+        {
+          const double r = unit_real<double>(random_uint64());
+          const double gap = (log_q_ == 0.0) ? 0.0 : std::floor(std::log1p(-r) / log_q_);
+          // for tiny p the gap may exceed every integer type; a gap
+          // beyond the last candidate ends the shard
+          if (!(gap < remaining()))
+          {
+            v_ = row_end_;
+            break;
+          }
+
+          // offset into row v_, which may span many rows
+          double offset = static_cast<double>(w_) + 1 + gap;
+          if (directed_ && offset >= static_cast<double>(n_))
+          {
+            const double rows = std::floor(offset / static_cast<double>(n_));
+            v_ = std::min(row_end_, v_ + static_cast<uint64_t>(rows));
+            offset = std::max(0.0, offset - rows * static_cast<double>(n_));
+          }
+          while (v_ < row_end_ && offset >= static_cast<double>(row_length(v_)))
+          {
+            offset -= static_cast<double>(row_length(v_));
+            ++v_;
+          }
+          if (v_ >= row_end_)
+            break;
+          w_ = static_cast<int64_t>(offset);
+
+          // self loops are candidates in directed rows and dropped
+          if (!(directed_ && static_cast<uint64_t>(w_) == v_))
+            return edge(v_, static_cast<uint64_t>(w_));
+        }
+        throw std::out_of_range("erdos_renyi: all candidate edges visited");
+      }
+
+      // At most the remaining candidates, saturated to unknown when
+      // they do not fit size_t.
+      size_bounds size_hint() const
+      {
+        if (v_ >= row_end_)
+          return size_bounds::exact(0);
+        const double left = remaining();
+        if (left >= static_cast<double>(size_bounds::unbounded))
+          return size_bounds::unknown();
+        return size_bounds { 0, static_cast<size_t>(left) };
+      }
+
+      void save(state_writer & writer) const
+      {
+        writer.put(v_);
+        writer.put(w_);
+      }
+
+      void load(state_reader & reader)
+      {
+        reader.get(v_);
+        reader.get(w_);
+      }
+    };
+
+    // R-MAT: each edge descends scale levels of the adjacency matrix,
+    // choosing a quadrant with probabilities a, b, c, d. With noise > 0
+    // the probabilities are perturbed per level, which smooths the
+    // staircase degree distribution of plain R-MAT.
+    class RmatGen
+    {
+      unsigned scale_;
+      double a_, b_, c_;
+      double noise_;
+
+    public:
+
+      RmatGen(unsigned scale, double a, double b, double c, double noise)
+        : scale_(scale),
+          a_(a),
+          b_(b),
+          c_(c),
+          noise_(noise)
+      { }
+
+      edge operator()()
+      {
+        uint64_t src = 0, dst = 0;
+        for (unsigned level = 0; level < scale_; ++level)
+        {
+          double a = a_, b = b_, c = c_, d = 1.0 - a_ - b_ - c_;
+          if (noise_ > 0)
+          {
+            a *= 1.0 - noise_ + 2.0 * noise_ * unit_real<double>(random_uint64());
+            b *= 1.0 - noise_ + 2.0 * noise_ * unit_real<double>(random_uint64());
+            c *= 1.0 - noise_ + 2.0 * noise_ * unit_real<double>(random_uint64());
+            d *= 1.0 - noise_ + 2.0 * noise_ * unit_real<double>(random_uint64());
+            const double total = a + b + c + d;
+            a /= total;
+            b /= total;
+            c /= total;
+          }
+
+          const double r = unit_real<double>(random_uint64());
+          const uint64_t down = (r >= a + b);
+          const uint64_t right = (r >= a && r < a + b) || (r >= a + b + c);
+          src = (src << 1) | down;
+          dst = (dst << 1) | right;
+        }
+        return edge(src, dst);
+      }
+
+      size_bounds size_hint() const
+      {
+        return size_bounds::infinite();
+      }
+    };
+
+    // Preferential attachment by the repeated-endpoint list: every edge
+    // appends both endpoints, so picking a uniform element of the list
+    // picks a node with probability proportional to its degree in O(1).
+    // Node v >= m attaches m edges; parallel edges are possible.
+    class BarabasiAlbertGen
+    {
+      uint64_t n_;
+      uint64_t m_;
+      uint64_t v_;
+      uint64_t j_;
+      std::vector<uint64_t> endpoints_;
+
+    public:
+
+      BarabasiAlbertGen(uint64_t n, uint64_t m)
+        : n_(n),
+          m_(m),
+          v_(m),
+          j_(0)
+      {
+        if (m == 0)
+          throw std::invalid_argument("barabasi_albert: m must be positive");
+        if (n > m)
+          endpoints_.reserve(static_cast<size_t>(2 * m * (n - m)));
+      }
+
+      edge operator()()
+      {
+        if (v_ >= n_)
+          throw std::out_of_range("barabasi_albert: all nodes attached");
+
+        uint64_t target;
+        if (v_ == m_)
+          target = j_;  // the first node links to the m seed nodes
+        else
+        {
+          // sample only endpoints from earlier nodes to avoid self loops
+          const uint64_t committed = endpoints_.size() - 2 * j_;
+          target = endpoints_[static_cast<size_t>(random_below(committed))];
+        }
+
+        const edge e(v_, target);
+        endpoints_.push_back(v_);
+        endpoints_.push_back(target);
+        if (++j_ == m_)
+        {
+          j_ = 0;
+          ++v_;
+        }
+        return e;
+      }
+
+      size_bounds size_hint() const
+      {
+        if (v_ >= n_)
+          return size_bounds::exact(0);
+        return size_bounds::exact(static_cast<size_t>((n_ - v_) * m_ - j_));
+      }
+
+      void save(state_writer & writer) const
+      {
+        writer.put(v_);
+        writer.put(j_);
+        writer.put(endpoints_);
+      }
+
+      void load(state_reader & reader)
+      {
+        reader.get(v_);
+        reader.get(j_);
+        reader.get(endpoints_);
+      }
+    };
+
+    // First row of shard k out of shards such that every shard covers
+    // about the same number of candidate pairs.
+    uint64_t erdos_renyi_row(uint64_t n, bool directed, unsigned k, unsigned shards)
+    {
+      if (k >= shards)
+        return n;
+      const double frac = static_cast<double>(k) / shards;
+      return static_cast<uint64_t>(directed ? n * frac : n * std::sqrt(frac));
+    }
+
+  } // namespace detail
+
+  // Edges of G(n, p) in row order. For parallel generation, shard k of
+  // shards covers a disjoint block of rows holding about 1/shards of
+  // the candidate pairs; run each shard on its own thread with its own
+  // engine seed and concatenate the results.
+  auto make_erdos_renyi_gen(uint64_t n, double p, bool directed = false,
+                            unsigned shard = 0, unsigned shards = 1)
+  {
+    return make_gen_from(detail::ErdosRenyiGen(
+      n, p, directed,
+      detail::erdos_renyi_row(n, directed, shard, shards),
+      detail::erdos_renyi_row(n, directed, shard + 1, shards)));
+  }
+
+  // Infinite stream of R-MAT edges over 2^scale nodes; use take(m) for
+  // m edges. Edges are independent, so shards are simply separate
+  // streams seeded differently. The defaults are the Graph500
+  // parameters.
+  auto make_rmat_gen(unsigned scale, double a = 0.57, double b = 0.19,
+                     double c = 0.19, double noise = 0.1)
+  {
+    if (a < 0 || b < 0 || c < 0 || a + b + c > 1.0)
+      throw std::invalid_argument("rmat: invalid quadrant probabilities");
+    return make_gen_from(detail::RmatGen(scale, a, b, c, noise));
+  }
+
+  // (n - m) * m edges of a Barabasi-Albert graph on n nodes.
+  auto make_barabasi_albert_gen(uint64_t n, uint64_t m)
+  {
+    return make_gen_from(detail::BarabasiAlbertGen(n, m));
+  }
+
+} // namespace gen
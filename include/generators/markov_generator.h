@@ -0,0 +1,288 @@
+#pragma once
+
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "generator.h"
+#include "alias_table.h"
+
+namespace gen {
+
+  // Character n-gram model compiled for sampling. Every context of
+  // order characters seen in the corpus is a state. The outcomes of
+  // all states are stored in flat arrays indexed through offsets; each
+  // outcome slot holds its character, an alias table entry, and the
+  // state reached by appending the character, so one step is one draw
+  // and a few array reads. The corpus is treated as cyclic so that
+  // every state has a successor.
+  class markov_model
+  {
+    static constexpr uint32_t MAGIC = 0x564b4d47;  // "GMKV"
+    static constexpr uint32_t VERSION = 1;
+
+    uint32_t order_;
+    std::vector<uint32_t> offsets_;
+    std::string chars_;
+    std::vector<uint32_t> next_;
+    std::vector<uint32_t> threshold_;
+    std::vector<uint32_t> alias_;
+    detail::alias_table start_;
+
+    markov_model() = default;
+
+  public:
+
+    markov_model(std::string_view corpus, unsigned order)
+      : order_(order)
+    {
+      if (corpus.size() <= order)
+        throw std::invalid_argument("markov_model: corpus must be longer than order");
+      if (corpus.size() > std::numeric_limits<uint32_t>::max())
+        throw std::length_error("markov_model: corpus larger than 4GB");
+
+      std::string text(corpus);
+      text.append(corpus.substr(0, order));
+
+      std::unordered_map<std::string_view, uint32_t> ids;
+      std::vector<uint32_t> state_of(corpus.size());
+      for (size_t pos = 0; pos < corpus.size(); ++pos)
+      {
+        auto inserted = ids.emplace(std::string_view(text).substr(pos, order),
+                                    static_cast<uint32_t>(ids.size()));
+        state_of[pos] = inserted.first->second;
+      }
+
+      const size_t states = ids.size();
+      std::vector<std::vector<std::pair<char, uint32_t>>> counts(states);
+      std::vector<uint32_t> occurrences(states);
+      for (size_t pos = 0; pos < corpus.size(); ++pos)
+      {
+        const uint32_t state = state_of[pos];
+        const char c = text[pos + order];
+        ++occurrences[state];
+        auto & outcomes = counts[state];
+        auto it = std::find_if(outcomes.begin(), outcomes.end(),
+                               [c](const auto & oc) { return oc.first == c; });
+        if (it == outcomes.end())
+          outcomes.emplace_back(c, 1);
+        else
+          ++it->second;
+      }
+
+      offsets_.reserve(states + 1);
+      offsets_.push_back(0);
+      for (const auto & outcomes : counts)
+        offsets_.push_back(offsets_.back() + static_cast<uint32_t>(outcomes.size()));
+
+      const size_t slots = offsets_.back();
+      chars_.resize(slots);
+      next_.resize(slots);
+      threshold_.resize(slots);
+      alias_.resize(slots);
+
+      std::vector<uint32_t> weights;
+      std::string successor;
+      for (uint32_t state = 0; state < states; ++state)
+      {
+        const auto & outcomes = counts[state];
+        const uint32_t base = offsets_[state];
+        weights.clear();
+        for (size_t k = 0; k < outcomes.size(); ++k)
+        {
+          chars_[base + k] = outcomes[k].first;
+          weights.push_back(outcomes[k].second);
+        }
+        detail::build_alias(weights.data(), static_cast<uint32_t>(weights.size()),
+                            &threshold_[base], &alias_[base]);
+      }
+
+      // A state's context is the order characters at any of its
+      // positions; the successor drops the first and appends c.
+      for (size_t pos = 0; pos < corpus.size(); ++pos)
+      {
+        const uint32_t state = state_of[pos];
+        const uint32_t next_state = state_of[(pos + 1) % corpus.size()];
+        const char c = text[pos + order];
+        for (uint32_t slot = offsets_[state]; slot < offsets_[state + 1]; ++slot)
+          if (chars_[slot] == c)
+            next_[slot] = next_state;
+      }
+
+      start_ = detail::alias_table(occurrences);
+    }
+
+    unsigned order() const
+    {
+      return order_;
+    }
+
+    uint32_t states() const
+    {
+      return static_cast<uint32_t>(offsets_.size() - 1);
+    }
+
+    // A state drawn in proportion to its frequency in the corpus.
+    uint32_t start(uint64_t bits) const
+    {
+      return start_(bits);
+    }
+
+    // Emits the next character and advances state.
+    char step(uint32_t & state, uint64_t bits) const
+    {
+      const uint32_t base = offsets_[state];
+      const uint32_t slot = base + detail::alias_sample(
+        &threshold_[base], &alias_[base], offsets_[state + 1] - base, bits);
+      state = next_[slot];
+      return chars_[slot];
+    }
+
+    // Binary format of the compiled tables, so that large corpora need
+    // not be retrained at startup. The layout is native-endian. load
+    // checks every offset and index against the table sizes and throws
+    // runtime_error for a truncated or corrupt file.
+    void save(std::ostream & os) const
+    {
+      std::string blob;
+      detail::state_writer writer(blob);
+      writer.put(MAGIC);
+      writer.put(VERSION);
+      writer.put(order_);
+      writer.put(offsets_);
+      writer.put(chars_);
+      writer.put(next_);
+      writer.put(threshold_);
+      writer.put(alias_);
+      start_.save(writer);
+      os.write(blob.data(), static_cast<std::streamsize>(blob.size()));
+    }
+
+    static markov_model load(std::istream & is)
+    {
+      const std::string blob((std::istreambuf_iterator<char>(is)),
+                             std::istreambuf_iterator<char>());
+      detail::state_reader reader(blob);
+      markov_model model;
+      try {
+        uint32_t magic, version;
+        reader.get(magic);
+        reader.get(version);
+        if (magic != MAGIC || version != VERSION)
+          throw std::runtime_error("markov_model: not a saved model");
+
+        reader.get(model.order_);
+        reader.get(model.offsets_);
+        reader.get(model.chars_);
+        reader.get(model.next_);
+        reader.get(model.threshold_);
+        reader.get(model.alias_);
+        model.start_.load(reader);
+      }
+      catch (const std::invalid_argument &) {  // from state_reader
+        throw std::runtime_error("markov_model: truncated model");
+      }
+
+      const size_t slots = model.chars_.size();
+      if (model.offsets_.size() < 2 || model.offsets_.front() != 0 ||
+          model.offsets_.back() != slots ||
+          model.next_.size() != slots || model.threshold_.size() != slots ||
+          model.alias_.size() != slots || model.start_.size() != model.states())
+        throw std::runtime_error("markov_model: inconsistent tables");
+
+      // every state has outcomes, and every outcome aliases within its
+      // state and leads to an existing state
+      const uint32_t states = model.states();
+      for (uint32_t state = 0; state < states; ++state)
+      {
+        const uint32_t base = model.offsets_[state];
+        const uint32_t end = model.offsets_[state + 1];
+        if (end <= base)
+          throw std::runtime_error("markov_model: state without outcomes");
+        for (uint32_t slot = base; slot < end; ++slot)
+          if (model.alias_[slot] >= end - base || model.next_[slot] >= states)
+            throw std::runtime_error("markov_model: index out of range");
+      }
+      return model;
+    }
+  };
+
+  namespace detail {
+
+    // Text of a fixed length per value. Consecutive values continue the
+    // same chain; the first state is drawn on the first call.
+    class MarkovTextGen
+    {
+      std::shared_ptr<const markov_model> model_;
+      size_t length_;
+      uint32_t state_;
+      bool started_;
+
+    public:
+
+      MarkovTextGen(std::shared_ptr<const markov_model> model, size_t length)
+        : model_(std::move(model)),
+          length_(length),
+          state_(0),
+          started_(false)
+      { }
+
+      std::string operator()()
+      {
+        std::string out;
+        generate_into(out);
+        return out;
+      }
+
+      void generate_into(std::string & out)
+      {
+        if (!started_)
+        {
+          state_ = model_->start(random_uint64());
+          started_ = true;
+        }
+        out.resize(length_);
+        const markov_model & model = *model_;
+        uint32_t state = state_;
+        for (char & c : out)
+          c = model.step(state, random_uint64());
+        state_ = state;
+      }
+
+      size_bounds size_hint() const
+      {
+        return size_bounds::infinite();
+      }
+
+      void save(state_writer & writer) const
+      {
+        writer.put(state_);
+        writer.put(started_);
+      }
+
+      void load(state_reader & reader)
+      {
+        reader.get(state_);
+        reader.get(started_);
+      }
+    };
+
+  } // namespace detail
+
+  // Strings of length characters sampled from model. Copies of the
+  // generator share the model.
+  auto make_markov_text_gen(std::shared_ptr<const markov_model> model, size_t length = 64)
+  {
+    return make_gen_from(detail::MarkovTextGen(std::move(model), length));
+  }
+
+  auto make_markov_text_gen(std::string_view corpus, unsigned order, size_t length = 64)
+  {
+    return make_markov_text_gen(std::make_shared<const markov_model>(corpus, order), length);
+  }
+
+} // namespace gen
@@ -0,0 +1,263 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "generator.h"
+
+// Strings matching a pattern in a small regex subset:
+//
+//   literals       abc, with \ escaping any special character
+//   classes        [a-z0-9_], [^,], ., \d, \w, \s
+//   quantifiers    {n}, {m,n}, {m,}, ?, *, +
+//
+// There is no alternation or grouping, so a pattern compiles to a
+// linear table of states, each emitting a literal run or a repeated
+// character class. Generation walks the table once without
+// backtracking. Open-ended quantifiers repeat at most max_repeat
+// times beyond their minimum.
+
+namespace gen {
+
+  namespace detail {
+
+    class PatternGen
+    {
+      struct state
+      {
+        std::string literal;     // emitted verbatim when chars is empty
+        boost::optional<CharsetGen> chars;
+        uint32_t min, max;
+      };
+
+      std::vector<state> states_;
+      size_t max_length_;
+
+      static std::string charset_of(const bool (&members)[256])
+      {
+        std::string chars;
+        for (int c = 0; c < 256; ++c)
+          if (members[c])
+            chars.push_back(static_cast<char>(c));
+        if (chars.empty())
+          throw std::invalid_argument("pattern: empty character class");
+        return chars;
+      }
+
+      static void add_escape(char c, bool (&members)[256])
+      {
+        auto add_range = [&members](char first, char last) {
+          for (int ch = first; ch <= last; ++ch)
+            members[static_cast<unsigned char>(ch)] = true;
+        };
+        switch (c)
+        {
+          case 'd': add_range('0', '9'); break;
+          case 'w': add_range('a', 'z'); add_range('A', 'Z');
+                    add_range('0', '9'); members['_'] = true; break;
+          case 's': members[' '] = true; members['\t'] = true; break;
+          case 'n': members['\n'] = true; break;
+          case 't': members['\t'] = true; break;
+          default:  members[static_cast<unsigned char>(c)] = true;
+        }
+      }
+
+      static bool is_class_escape(char c)
+      {
+        return c == 'd' || c == 'w' || c == 's';
+      }
+
+      static size_t parse_class(const std::string & pattern, size_t pos, bool (&members)[256])
+      {
+        bool negate = false;
+        if (pos < pattern.size() && pattern[pos] == '^')
+        {
+          negate = true;
+          ++pos;
+        }
+
+        bool first = true;
+        while (pos < pattern.size() && (pattern[pos] != ']' || first))
+        {
+          first = false;
+          char lo = pattern[pos++];
+          if (lo == '\\')
+          {
+            if (pos == pattern.size())
+              break;
+            const char esc = pattern[pos++];
+            if (is_class_escape(esc))
+            {
+              add_escape(esc, members);
+              continue;
+            }
+            bool single[256] = {};
+            add_escape(esc, single);
+            lo = charset_of(single)[0];
+          }
+          if (pos + 1 < pattern.size() && pattern[pos] == '-' && pattern[pos + 1] != ']')
+          {
+            char hi = pattern[pos + 1];
+            pos += 2;
+            if (hi == '\\' && pos < pattern.size())
+              hi = pattern[pos++];
+            if (static_cast<unsigned char>(hi) < static_cast<unsigned char>(lo))
+              throw std::invalid_argument("pattern: reversed range in character class");
+            for (int ch = static_cast<unsigned char>(lo); ch <= static_cast<unsigned char>(hi); ++ch)
+              members[ch] = true;
+          }
+          else
+            members[static_cast<unsigned char>(lo)] = true;
+        }
+        if (pos == pattern.size())
+          throw std::invalid_argument("pattern: unterminated character class");
+
+        if (negate)  // complement within printable ASCII
+          for (int ch = 0; ch < 256; ++ch)
+            members[ch] = (ch >= ' ' && ch <= '~') && !members[ch];
+        return pos + 1;
+      }
+
+      // Parses a quantifier at pos, if any, into [min, max].
+      static size_t parse_quantifier(const std::string & pattern, size_t pos,
+                                     uint32_t max_repeat, uint32_t & min, uint32_t & max)
+      {
+        min = max = 1;
+        if (pos == pattern.size())
+          return pos;
+
+        switch (pattern[pos])
+        {
+          case '?': min = 0; max = 1; return pos + 1;
+          case '*': min = 0; max = max_repeat; return pos + 1;
+          case '+': min = 1; max = 1 + max_repeat; return pos + 1;
+          case '{': break;
+          default: return pos;
+        }
+
+        const size_t close = pattern.find('}', pos);
+        if (close == std::string::npos)
+          throw std::invalid_argument("pattern: unterminated quantifier");
+        const std::string body = pattern.substr(pos + 1, close - pos - 1);
+        const size_t comma = body.find(',');
+        try {
+          min = static_cast<uint32_t>(std::stoul(body.substr(0, comma)));
+          if (comma == std::string::npos)
+            max = min;
+          else if (comma + 1 == body.size())
+            max = min + max_repeat;
+          else
+            max = static_cast<uint32_t>(std::stoul(body.substr(comma + 1)));
+        }
+        catch (const std::logic_error &) {
+          throw std::invalid_argument("pattern: malformed quantifier {" + body + "}");
+        }
+        if (max < min)
+          throw std::invalid_argument("pattern: quantifier maximum below minimum");
+        return close + 1;
+      }
+
+    public:
+
+      // the character sets only cache engine bits
+      static constexpr bool has_position = false;
+
+      PatternGen(const std::string & pattern, uint32_t max_repeat)
+        : max_length_(0)
+      {
+        size_t pos = 0;
+        while (pos < pattern.size())
+        {
+          bool members[256] = {};
+          bool is_class = true;
+          char literal = 0;
+
+          const char c = pattern[pos++];
+          if (c == '[')
+            pos = parse_class(pattern, pos, members);
+          else if (c == '.')
+            for (int ch = ' '; ch <= '~'; ++ch)
+              members[ch] = true;
+          else if (c == '\\')
+          {
+            if (pos == pattern.size())
+              throw std::invalid_argument("pattern: trailing backslash");
+            const char esc = pattern[pos++];
+            if (is_class_escape(esc))
+              add_escape(esc, members);
+            else
+            {
+              add_escape(esc, members);
+              literal = charset_of(members)[0];
+              is_class = false;
+            }
+          }
+          else if (c == '?' || c == '*' || c == '+' || c == '{')
+            throw std::invalid_argument("pattern: quantifier without operand");
+          else
+          {
+            literal = c;
+            is_class = false;
+          }
+
+          uint32_t min, max;
+          pos = parse_quantifier(pattern, pos, max_repeat, min, max);
+
+          if (!is_class && min == 1 && max == 1 &&
+              !states_.empty() && !states_.back().chars &&
+              states_.back().min == 1 && states_.back().max == 1)
+            states_.back().literal.push_back(literal);  // extend the run
+          else if (!is_class)
+            states_.push_back(state { std::string(1, literal), boost::none, min, max });
+          else
+            states_.push_back(state { std::string(), CharsetGen(charset_of(members)), min, max });
+        }
+
+        for (const state & s : states_)
+          max_length_ += s.max * (s.chars ? 1 : s.literal.size());
+      }
+
+      std::string operator()()
+      {
+        std::string out;
+        generate_into(out);
+        return out;
+      }
+
+      void generate_into(std::string & out)
+      {
+        out.clear();
+        out.reserve(max_length_);
+        for (state & s : states_)
+        {
+          const uint32_t count = (s.min == s.max) ? s.min :
+            s.min + static_cast<uint32_t>(random_below(s.max - s.min + 1));
+          if (s.chars)
+          {
+            const size_t old = out.size();
+            out.resize(old + count);
+            s.chars->generate_n(&out[old], count);
+          }
+          else
+            for (uint32_t i = 0; i < count; ++i)
+              out.append(s.literal);
+        }
+      }
+
+      size_bounds size_hint() const
+      {
+        return size_bounds::infinite();
+      }
+    };
+
+  } // namespace detail
+
+  // e.g., make_pattern_gen("[A-Z]{3}-[0-9]{4}") yields "QXT-0421".
+  // The pattern is compiled once; generate_into refills an existing
+  // string without reallocating.
+  auto make_pattern_gen(const std::string & pattern, unsigned int max_repeat = 8)
+  {
+    return make_gen_from(detail::PatternGen(pattern, max_repeat));
+  }
+
+} // namespace gen
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "generator.h"
+#include "arena.h"
+
+// Size-bounded recursive structures (trees, ASTs, documents). The
+// generator hands its build function a budget of nodes; the function
+// spends one on the current node and splits the rest among the
+// children it builds through recurse, so every value has at most size
+// nodes no matter how the choices fall. Nodes come from an arena that
+// belongs to the generated value and is released in one step.
+
+namespace gen {
+
+  // A generated root together with the arena holding its nodes.
+  template <class T>
+  class arena_tree
+  {
+    std::unique_ptr<gen::arena> arena_;
+
+  public:
+
+    T root {};
+
+    gen::arena & arena()
+    {
+      if (!arena_)
+        arena_ = std::make_unique<gen::arena>();
+      return *arena_;
+    }
+
+    // Drops the previous root and frees its nodes, keeping the arena.
+    void reset()
+    {
+      root = T {};
+      if (arena_)
+        arena_->release();
+    }
+  };
+
+  // Writes parts budgets summing to budget, cut at parts - 1 uniform
+  // random points (so parts may be zero).
+  template <class OutIter>
+  OutIter split_budget(size_t budget, size_t parts, OutIter out)
+  {
+    if (parts == 0)
+      return out;
+
+    // the usual handful of children needs no allocation
+    size_t local[16];
+    std::vector<size_t> heap;
+    size_t * cuts = local;
+    if (parts - 1 > 16)
+    {
+      heap.resize(parts - 1);
+      cuts = heap.data();
+    }
+    for (size_t i = 0; i < parts - 1; ++i)
+      cuts[i] = static_cast<size_t>(random_below(budget + 1));
+    std::sort(cuts, cuts + parts - 1);
+
+    size_t prev = 0;
+    for (size_t i = 0; i < parts - 1; ++i)
+    {
+      *out++ = cuts[i] - prev;
+      prev = cuts[i];
+    }
+    *out++ = budget - prev;
+    return out;
+  }
+
+  namespace detail {
+
+    template <class T, class Func>
+    class Recurse
+    {
+      Func & func_;
+      gen::arena & arena_;
+      unsigned int depth_;
+
+    public:
+
+      Recurse(Func & func, gen::arena & arena)
+        : func_(func),
+          arena_(arena),
+          depth_(0)
+      { }
+
+      // Builds a subtree of at most budget nodes.
+      T operator()(size_t budget)
+      {
+        ++depth_;
+        T value = func_(*this, budget);
+        --depth_;
+        return value;
+      }
+
+      // 1 for the root, 2 for its children, and so on.
+      unsigned int depth() const
+      {
+        return depth_;
+      }
+
+      gen::arena & arena()
+      {
+        return arena_;
+      }
+
+      template <class U, class... Args>
+      U * make(Args&&... args)
+      {
+        return arena_.template make<U>(std::forward<Args>(args)...);
+      }
+    };
+
+    template <class T, class Func>
+    class RecursiveGen
+    {
+      Func func_;
+      size_t size_;
+
+    public:
+
+      RecursiveGen(Func func, size_t size)
+        : func_(std::move(func)),
+          size_(size)
+      { }
+
+      arena_tree<T> operator()()
+      {
+        arena_tree<T> tree;
+        generate_into(tree);
+        return tree;
+      }
+
+      // Reuses the arena of a previous tree; its nodes are freed first.
+      void generate_into(arena_tree<T> & tree)
+      {
+        tree.reset();
+        Recurse<T, Func> recurse(func_, tree.arena());
+        tree.root = recurse(size_);
+      }
+
+      size_bounds size_hint() const
+      {
+        return size_bounds::infinite();
+      }
+    };
+
+  } // namespace detail
+
+  // func(recurse, budget) builds one node with budget >= 1 and its
+  // children through recurse(child_budget), using recurse.make<Node>()
+  // for arena allocation and recurse.depth() for depth limits, e.g.
+  //
+  //   auto treegen = make_recursive_gen<Node *>([](auto & recurse, size_t budget) {
+  //     size_t parts[2];
+  //     split_budget(budget - 1, 2, parts);
+  //     Node * node = recurse.template make<Node>();
+  //     node->left = parts[0] ? recurse(parts[0]) : nullptr;
+  //     node->right = parts[1] ? recurse(parts[1]) : nullptr;
+  //     return node;
+  //   }, 100);
+  template <class T, class Func>
+  auto make_recursive_gen(Func func, size_t size)
+  {
+    if (size == 0)
+      throw std::invalid_argument("recursive_gen: size must be positive");
+    return make_gen_from(detail::RecursiveGen<T, Func>(std::move(func), size));
+  }
+
+} // namespace gen
@@ -0,0 +1,675 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "generator.h"
+
+// Runtime counterpart of the GenFactory pipelines. A schema is a tree
+// of fields built at run time; schema_plan compiles it once into a
+// flat list of kernels, and every batch fills columnar buffers with
+// one tight loop per field instead of one generator call per value.
+//
+// Column layout (one column per field, nested fields as children):
+//
+//   primitives       data holds rows values of the field's C++ type
+//   string           offsets (rows + 1) into the characters in data
+//   vector, list     offsets (rows + 1) into the single child column
+//   optional         valid flags; the child has a value in every row
+//   array            the child holds rows * dim values
+//   tuple            one child column per member, rows values each
+//   pointer,         the child holds the pointee of every row
+//   shared_ptr
+
+namespace gen {
+
+  enum class field_kind : uint8_t
+  {
+    boolean, character,
+    int8, int16, int32, int64,
+    uint8, uint16, uint32, uint64,
+    float32, float64, float_ext,
+    string, vector, list, optional, array, tuple,
+    pointer, shared_ptr
+  };
+
+  struct field
+  {
+    field_kind kind;
+    std::string name;
+    int64_t min = 0, max = 0;        // integers; min == max == 0 is the full range
+    double lo = 0, hi = 1;           // floating point, [lo, hi)
+    std::string charset;             // character, string; empty is printable
+    unsigned int max_length = DEFAULT_MAX_SEQ_LEN;  // string, vector, list
+    bool possibly_empty = false;     // string, vector, list
+    size_t dim = 1;                  // array
+    double null_probability = 0.5;   // optional
+    std::vector<field> children;     // element, or tuple members
+
+    field(field_kind kind, std::string name)
+      : kind(kind),
+        name(std::move(name))
+    { }
+  };
+
+  namespace schema {
+
+    field boolean(std::string name)
+    {
+      return field { field_kind::boolean, std::move(name) };
+    }
+
+    field character(std::string name, std::string charset = "")
+    {
+      field f { field_kind::character, std::move(name) };
+      f.charset = std::move(charset);
+      return f;
+    }
+
+    field integer(field_kind kind, std::string name, int64_t min = 0, int64_t max = 0)
+    {
+      field f { kind, std::move(name) };
+      f.min = min;
+      f.max = max;
+      return f;
+    }
+
+    field real(field_kind kind, std::string name, double lo = 0, double hi = 1)
+    {
+      field f { kind, std::move(name) };
+      f.lo = lo;
+      f.hi = hi;
+      return f;
+    }
+
+    field string(std::string name, unsigned int max_length = DEFAULT_MAX_STR_LEN,
+                 std::string charset = "", bool possibly_empty = false)
+    {
+      field f { field_kind::string, std::move(name) };
+      f.max_length = max_length;
+      f.charset = std::move(charset);
+      f.possibly_empty = possibly_empty;
+      return f;
+    }
+
+    field vector(std::string name, field elem,
+                 unsigned int max_length = DEFAULT_MAX_SEQ_LEN, bool possibly_empty = false)
+    {
+      field f { field_kind::vector, std::move(name) };
+      f.max_length = max_length;
+      f.possibly_empty = possibly_empty;
+      f.children.push_back(std::move(elem));
+      return f;
+    }
+
+    field list(std::string name, field elem,
+               unsigned int max_length = DEFAULT_MAX_SEQ_LEN, bool possibly_empty = false)
+    {
+      field f = vector(std::move(name), std::move(elem), max_length, possibly_empty);
+      f.kind = field_kind::list;
+      return f;
+    }
+
+    field optional(std::string name, field elem, double null_probability = 0.5)
+    {
+      field f { field_kind::optional, std::move(name) };
+      f.null_probability = null_probability;
+      f.children.push_back(std::move(elem));
+      return f;
+    }
+
+    field array(std::string name, field elem, size_t dim)
+    {
+      field f { field_kind::array, std::move(name) };
+      f.dim = dim;
+      f.children.push_back(std::move(elem));
+      return f;
+    }
+
+    field tuple(std::string name, std::vector<field> members)
+    {
+      field f { field_kind::tuple, std::move(name) };
+      f.children = std::move(members);
+      return f;
+    }
+
+    field pointer(std::string name, field pointee)
+    {
+      field f { field_kind::pointer, std::move(name) };
+      f.children.push_back(std::move(pointee));
+      return f;
+    }
+
+    field shared_ptr(std::string name, field pointee)
+    {
+      field f { field_kind::shared_ptr, std::move(name) };
+      f.children.push_back(std::move(pointee));
+      return f;
+    }
+
+  } // namespace schema
+
+  struct column
+  {
+    field_kind kind;
+    std::string name;
+    size_t rows = 0;
+    std::vector<unsigned char> data;
+    std::vector<uint32_t> offsets;
+    std::vector<uint8_t> valid;
+    std::vector<column> children;
+
+    column(field_kind kind, std::string name)
+      : kind(kind),
+        name(std::move(name))
+    { }
+
+    template <class T>
+    const T * values() const
+    {
+      return reinterpret_cast<const T *>(data.data());
+    }
+
+    std::string_view text(size_t row) const
+    {
+      return std::string_view(reinterpret_cast<const char *>(data.data()) + offsets[row],
+                              offsets[row + 1] - offsets[row]);
+    }
+  };
+
+  struct record_batch
+  {
+    size_t rows = 0;
+    std::vector<column> columns;
+
+    const column & operator [] (const std::string & name) const
+    {
+      for (const column & col : columns)
+        if (col.name == name)
+          return col;
+      throw std::invalid_argument("record_batch: no column named " + name);
+    }
+  };
+
+  namespace detail {
+
+    template <class Func>
+    decltype(auto) visit_primitive(field_kind kind, Func && func)
+    {
+      switch (kind)
+      {
+        case field_kind::boolean:   return func(bool());
+        case field_kind::character: return func(char());
+        case field_kind::int8:      return func(int8_t());
+        case field_kind::int16:     return func(int16_t());
+        case field_kind::int32:     return func(int32_t());
+        case field_kind::int64:     return func(int64_t());
+        case field_kind::uint8:     return func(uint8_t());
+        case field_kind::uint16:    return func(uint16_t());
+        case field_kind::uint32:    return func(uint32_t());
+        case field_kind::uint64:    return func(uint64_t());
+        case field_kind::float32:   return func(float());
+        case field_kind::float64:   return func(double());
+        case field_kind::float_ext: return func(static_cast<long double>(0));
+        default:
+          throw std::invalid_argument("schema: not a primitive field kind");
+      }
+    }
+
+    bool is_primitive(field_kind kind)
+    {
+      return kind <= field_kind::float_ext;
+    }
+
+  } // namespace detail
+
+  // Compiled form of a schema. Fields are flattened in preorder; each
+  // kernel fills the column of one field for the number of rows its
+  // parent requested, and sets the row counts of its children.
+  class schema_plan
+  {
+    struct kernel
+    {
+      field_kind kind;
+      uint32_t subtree;          // number of kernels in this field's subtree
+      uint64_t base, range;      // integers: base + bits % range; range 0 is every bit pattern
+      double lo, width;          // floating point
+      uint32_t null_threshold;   // optional: null when the low draw bits fall below
+      unsigned int max_length;
+      bool possibly_empty;
+      size_t dim;
+      boost::optional<detail::CharsetGen> chars;
+    };
+
+    std::vector<field> fields_;
+    std::vector<kernel> kernels_;
+    std::vector<size_t> rows_;
+    std::vector<column *> columns_;
+
+    void compile(const field & f)
+    {
+      const size_t index = kernels_.size();
+      kernels_.push_back(kernel { f.kind, 1, 0, 0, 0, 0, 0, f.max_length,
+                                  f.possibly_empty, f.dim, boost::none });
+      kernel & k = kernels_.back();
+
+      size_t expected_children = 1;
+      if (detail::is_primitive(f.kind) || f.kind == field_kind::string)
+        expected_children = 0;
+      else if (f.kind == field_kind::tuple)
+        expected_children = std::max<size_t>(f.children.size(), 1);
+      if (f.children.size() != expected_children)
+        throw std::invalid_argument("schema: wrong number of children in field " + f.name);
+
+      switch (f.kind)
+      {
+        case field_kind::int8: case field_kind::int16:
+        case field_kind::int32: case field_kind::int64:
+        case field_kind::uint8: case field_kind::uint16:
+        case field_kind::uint32: case field_kind::uint64:
+          if (f.min > f.max)
+            throw std::invalid_argument("schema: min above max in field " + f.name);
+          if (f.min != 0 || f.max != 0)
+          {
+            k.base = static_cast<uint64_t>(f.min);
+            k.range = static_cast<uint64_t>(f.max) - static_cast<uint64_t>(f.min) + 1;
+          }
+          break;
+        case field_kind::float32: case field_kind::float64: case field_kind::float_ext:
+          if (!(f.lo < f.hi))
+            throw std::invalid_argument("schema: lo must be less than hi in field " + f.name);
+          k.lo = f.lo;
+          k.width = f.hi - f.lo;
+          break;
+        case field_kind::character: case field_kind::string:
+          k.chars = detail::CharsetGen(f.charset.empty() ? detail::char_range(' ', '~')
+                                                         : f.charset);
+          if (f.kind == field_kind::string && f.max_length == 0 && !f.possibly_empty)
+            throw std::invalid_argument("schema: max_length must be positive in field " + f.name);
+          break;
+        case field_kind::vector: case field_kind::list:
+          if (f.max_length == 0 && !f.possibly_empty)
+            throw std::invalid_argument("schema: max_length must be positive in field " + f.name);
+          break;
+        case field_kind::optional:
+          k.null_threshold = static_cast<uint32_t>(
+            std::min(std::max(f.null_probability, 0.0), 1.0) * 4294967295.0);
+          break;
+        default:
+          break;
+      }
+
+      for (const field & child : f.children)
+        compile(child);
+      kernels_[index].subtree = static_cast<uint32_t>(kernels_.size() - index);
+    }
+
+    static column skeleton(const field & f)
+    {
+      column col { f.kind, f.name };
+      for (const field & child : f.children)
+        col.children.push_back(skeleton(child));
+      return col;
+    }
+
+    static void flatten(column & col, std::vector<column *> & out)
+    {
+      out.push_back(&col);
+      for (column & child : col.children)
+        flatten(child, out);
+    }
+
+    template <class T>
+    static void fill_integers(T * out, size_t n, uint64_t base, uint64_t range)
+    {
+      if (range == 0)
+        for (size_t i = 0; i < n; ++i)
+          out[i] = static_cast<T>(random_uint64());
+      else
+        for (size_t i = 0; i < n; ++i)
+          out[i] = static_cast<T>(base + random_uint64() % range);
+    }
+
+    // Lengths drawn like make_string_gen and make_seq_gen; returns the total.
+    static size_t fill_offsets(std::vector<uint32_t> & offsets, size_t n,
+                               unsigned int max_length, bool possibly_empty)
+    {
+      offsets.resize(n + 1);
+      offsets[0] = 0;
+      for (size_t i = 0; i < n; ++i)
+      {
+        const uint32_t length = static_cast<uint32_t>(
+          possibly_empty ? random_below(max_length + 1) : random_below(max_length) + 1);
+        offsets[i + 1] = offsets[i] + length;
+      }
+      return offsets[n];
+    }
+
+    void run(size_t index)
+    {
+      kernel & k = kernels_[index];
+      column & col = *columns_[index];
+      const size_t n = rows_[index];
+      col.rows = n;
+
+      if (detail::is_primitive(k.kind))
+      {
+        detail::visit_primitive(k.kind, [&](auto zero) {
+          typedef decltype(zero) T;
+          col.data.resize(n * sizeof(T));
+          T * out = reinterpret_cast<T *>(col.data.data());
+          if constexpr (std::is_same<T, bool>::value)
+          {
+            for (size_t i = 0; i < n; i += 64)
+            {
+              uint64_t bits = random_uint64();
+              for (size_t j = i; j < n && j < i + 64; ++j, bits >>= 1)
+                out[j] = bits & 1;
+            }
+          }
+          else if constexpr (std::is_same<T, char>::value)
+            k.chars->generate_n(out, n);
+          else if constexpr (std::is_floating_point<T>::value)
+          {
+            const T below_hi = std::nextafter(static_cast<T>(k.lo + k.width), static_cast<T>(k.lo));
+            for (size_t i = 0; i < n; ++i)
+              out[i] = std::min(static_cast<T>(k.lo + k.width * detail::unit_real<double>(random_uint64())),
+                                below_hi);
+          }
+          else
+            fill_integers(out, n, k.base, k.range);
+        });
+        return;
+      }
+
+      const size_t first_child = index + 1;
+      switch (k.kind)
+      {
+        case field_kind::string:
+        {
+          const size_t total = fill_offsets(col.offsets, n, k.max_length, k.possibly_empty);
+          col.data.resize(total);
+          k.chars->generate_n(reinterpret_cast<char *>(col.data.data()), total);
+          break;
+        }
+        case field_kind::vector: case field_kind::list:
+          rows_[first_child] = fill_offsets(col.offsets, n, k.max_length, k.possibly_empty);
+          break;
+        case field_kind::optional:
+          col.valid.resize(n);
+          for (size_t i = 0; i < n; ++i)
+            col.valid[i] = static_cast<uint32_t>(random_uint64()) >= k.null_threshold;
+          rows_[first_child] = n;
+          break;
+        case field_kind::array:
+          rows_[first_child] = n * k.dim;
+          break;
+        case field_kind::pointer: case field_kind::shared_ptr:
+          rows_[first_child] = n;
+          break;
+        case field_kind::tuple:
+          for (size_t child = first_child; child < index + k.subtree; child += kernels_[child].subtree)
+            rows_[child] = n;
+          break;
+        default:
+          break;
+      }
+    }
+
+  public:
+
+    explicit schema_plan(std::vector<field> fields)
+      : fields_(std::move(fields))
+    {
+      if (fields_.empty())
+        throw std::invalid_argument("schema: no fields");
+      for (const field & f : fields_)
+        compile(f);
+      rows_.resize(kernels_.size());
+    }
+
+    const std::vector<field> & fields() const
+    {
+      return fields_;
+    }
+
+    // Refills batch with rows records, reusing its buffers when it
+    // already has the shape of this schema.
+    void generate_into(record_batch & batch, size_t rows)
+    {
+      columns_.clear();
+      for (column & col : batch.columns)
+        flatten(col, columns_);
+      bool same_shape = columns_.size() == kernels_.size();
+      for (size_t i = 0; same_shape && i < columns_.size(); ++i)
+        same_shape = columns_[i]->kind == kernels_[i].kind;
+      if (!same_shape)
+      {
+        batch.columns.clear();
+        for (const field & f : fields_)
+          batch.columns.push_back(skeleton(f));
+        columns_.clear();
+        for (column & col : batch.columns)
+          flatten(col, columns_);
+      }
+
+      batch.rows = rows;
+      for (size_t top = 0; top < kernels_.size(); top += kernels_[top].subtree)
+        rows_[top] = rows;
+      for (size_t index = 0; index < kernels_.size(); ++index)
+        run(index);
+    }
+
+    record_batch generate(size_t rows)
+    {
+      record_batch batch;
+      generate_into(batch, rows);
+      return batch;
+    }
+  };
+
+  namespace detail {
+
+    class SchemaGen
+    {
+      schema_plan plan_;
+      size_t rows_;
+
+    public:
+
+      SchemaGen(std::vector<field> fields, size_t rows)
+        : plan_(std::move(fields)),
+          rows_(rows)
+      { }
+
+      record_batch operator()()
+      {
+        return plan_.generate(rows_);
+      }
+
+      void generate_into(record_batch & batch)
+      {
+        plan_.generate_into(batch, rows_);
+      }
+
+      size_bounds size_hint() const
+      {
+        return size_bounds::infinite();
+      }
+    };
+
+  } // namespace detail
+
+  // Batches of rows records each. Copies of the generator have their
+  // own plan, so they can run on different threads.
+  auto make_schema_gen(std::vector<field> fields, size_t rows)
+  {
+    return make_gen_from(detail::SchemaGen(std::move(fields), rows));
+  }
+
+  // Spelling of the C++ type a field stands for, e.g.
+  // "std::vector<int32_t>", as GenFactory would generate it.
+  std::string type_name(const field & f)
+  {
+    static const char * const primitives[] = {
+      "bool", "char", "int8_t", "int16_t", "int32_t", "int64_t",
+      "uint8_t", "uint16_t", "uint32_t", "uint64_t",
+      "float", "double", "long double"
+    };
+    if (detail::is_primitive(f.kind))
+      return primitives[static_cast<size_t>(f.kind)];
+
+    switch (f.kind)
+    {
+      case field_kind::string:     return "std::string";
+      case field_kind::vector:     return "std::vector<" + type_name(f.children[0]) + ">";
+      case field_kind::list:       return "std::list<" + type_name(f.children[0]) + ">";
+      case field_kind::optional:   return "boost::optional<" + type_name(f.children[0]) + ">";
+      case field_kind::array:
+        return "std::array<" + type_name(f.children[0]) + ", " + std::to_string(f.dim) + ">";
+      case field_kind::pointer:    return type_name(f.children[0]) + " *";
+      case field_kind::shared_ptr: return "std::shared_ptr<" + type_name(f.children[0]) + ">";
+      default:
+      {
+        std::string name = "std::tuple<";
+        for (size_t i = 0; i < f.children.size(); ++i)
+          name += (i ? ", " : "") + type_name(f.children[i]);
+        return name + ">";
+      }
+    }
+  }
+
+  namespace detail {
+
+    // typegen::detail::TypeMap by index, as field kinds.
+    constexpr field_kind TYPE_MAP_KINDS[] = {
+      field_kind::boolean, field_kind::character,
+      field_kind::int8, field_kind::int16, field_kind::int32, field_kind::int64,
+      field_kind::uint8, field_kind::uint16, field_kind::uint32, field_kind::uint64,
+      field_kind::float32, field_kind::float64, field_kind::float_ext,
+      field_kind::vector, field_kind::array, field_kind::tuple,
+      field_kind::shared_ptr, field_kind::pointer, field_kind::optional
+    };
+    constexpr uint32_t TYPE_MAP_SIZE = 19;
+    constexpr uint32_t TYPE_MAP_PRIMITIVES = 13;
+    constexpr uint32_t TYPE_MAP_NO_INDIRECTION = 16;
+
+    std::vector<field> random_members(size_t size, unsigned depth, unsigned max_depth);
+
+    // Same choices as TypeMap: elements of sequences and arrays, and
+    // targets of pointers and optionals, are never pointers or
+    // optionals. Fields at max_depth are primitives so that the tree
+    // stays finite.
+    field random_field(std::string name, uint32_t choices, unsigned depth, unsigned max_depth)
+    {
+      if (depth >= max_depth)
+        choices = TYPE_MAP_PRIMITIVES;
+
+      const field_kind kind = TYPE_MAP_KINDS[random_below(choices)];
+      auto inner = [depth, max_depth]() {
+        return random_field("elem", TYPE_MAP_NO_INDIRECTION, depth + 1, max_depth);
+      };
+      switch (kind)
+      {
+        case field_kind::vector:     return schema::vector(std::move(name), inner());
+        case field_kind::array:
+        {
+          field elem = inner();
+          return schema::array(std::move(name), std::move(elem), random_below(10) + 1);
+        }
+        case field_kind::tuple:
+          return schema::tuple(std::move(name),
+                               random_members(random_below(18) + 1, depth + 1, max_depth));
+        case field_kind::shared_ptr: return schema::shared_ptr(std::move(name), inner());
+        case field_kind::pointer:    return schema::pointer(std::move(name), inner());
+        case field_kind::optional:   return schema::optional(std::move(name), inner());
+        default:                     return field { kind, std::move(name) };
+      }
+    }
+
+    // Replacement types for repeated draws, in generations. The first
+    // holds every primitive and, below max_depth, every vector,
+    // shared_ptr, pointer and optional of a primitive; generation g > 0
+    // holds the arrays of dimension g of every primitive, so below
+    // max_depth the supply never runs out. At max_depth the members
+    // are capped to the primitives, which the first generation covers.
+    std::vector<field> shallow_fields(unsigned depth, unsigned max_depth, size_t generation)
+    {
+      std::vector<field> fields;
+      if (generation == 0)
+      {
+        for (uint32_t i = 0; i < TYPE_MAP_PRIMITIVES; ++i)
+          fields.push_back(field { TYPE_MAP_KINDS[i], "elem" });
+        if (depth < max_depth)
+          for (uint32_t i = 0; i < TYPE_MAP_PRIMITIVES; ++i)
+          {
+            fields.push_back(schema::vector("", fields[i]));
+            fields.push_back(schema::shared_ptr("", fields[i]));
+            fields.push_back(schema::pointer("", fields[i]));
+            fields.push_back(schema::optional("", fields[i]));
+          }
+      }
+      else if (depth < max_depth)
+        for (uint32_t i = 0; i < TYPE_MAP_PRIMITIVES; ++i)
+          fields.push_back(schema::array("", field { TYPE_MAP_KINDS[i], "elem" }, generation));
+      return fields;
+    }
+
+    // Members of distinct types, like typegen's NextUniqueType. A draw
+    // that repeats a type is replaced by one of the unused shallow
+    // types instead of redrawn, which could go on forever when the
+    // draws are not random (an exhausted byte_entropy returns zeros).
+    std::vector<field> random_members(size_t size, unsigned depth, unsigned max_depth)
+    {
+      if (depth >= max_depth)
+        size = std::min<size_t>(size, TYPE_MAP_PRIMITIVES);
+
+      std::vector<field> members;
+      std::vector<std::string> types;
+      std::vector<field> unused;
+      size_t generation = 0;
+      auto is_used = [&types](const field & u) {
+        return std::find(types.begin(), types.end(), type_name(u)) != types.end();
+      };
+      while (members.size() < size)
+      {
+        std::string name = "f" + std::to_string(members.size());
+        field f = random_field(name, TYPE_MAP_SIZE, depth, max_depth);
+        std::string type = type_name(f);
+        if (std::find(types.begin(), types.end(), type) != types.end())
+        {
+          unused.erase(std::remove_if(unused.begin(), unused.end(), is_used), unused.end());
+          while (unused.empty())
+          {
+            unused = shallow_fields(depth, max_depth, generation++);
+            unused.erase(std::remove_if(unused.begin(), unused.end(), is_used), unused.end());
+          }
+          f = unused[random_below(unused.size())];
+          f.name = std::move(name);
+          type = type_name(f);
+        }
+        types.push_back(std::move(type));
+        members.push_back(std::move(f));
+      }
+      return members;
+    }
+
+  } // namespace detail
+
+  // Run-time typegen::RandomTuple: size top-level fields of distinct
+  // random types, nested at most max_depth levels. The schema is drawn
+  // from the engine, so it is reproducible from the seed; pass it to
+  // schema_plan or make_schema_gen to populate it.
+  std::vector<field> random_schema(size_t size = 24, unsigned int max_depth = 3)
+  {
+    return detail::random_members(size, 0, max_depth);
+  }
+
+  auto make_random_schema_gen(size_t size = 24, unsigned int max_depth = 3)
+  {
+    return make_gen_from([size, max_depth]() {
+      return random_schema(size, max_depth);
+    });
+  }
+
+} // namespace gen
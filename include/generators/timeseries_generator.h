@@ -0,0 +1,210 @@
+#pragma once
+
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "generator.h"
+
+// Timestamped series of the form
+//
+//   value(t) = level + trend * (t - start)
+//            + sum of amplitude * sin(2 pi (t - start) / period + phase)
+//            + random walk + gaussian noise
+//
+// sampled every interval time units from start.
+
+namespace gen {
+
+  typedef std::pair<int64_t, double> timeseries_point;
+
+  namespace detail {
+
+    constexpr double two_pi = 6.283185307179586476925;
+
+  } // namespace detail
+
+  struct seasonal_component
+  {
+    double period;     // in time units
+    double amplitude;
+    double phase = 0;  // in radians
+  };
+
+  struct timeseries
+  {
+    int64_t start = 0;
+    int64_t interval = 1;
+    double level = 0;
+    double trend = 0;  // per time unit
+    std::vector<seasonal_component> seasonal;
+    double walk_sigma = 0;   // step deviation of the random walk
+    double noise_sigma = 0;  // deviation of the independent noise
+
+    int64_t timestamp(uint64_t index) const
+    {
+      return start + static_cast<int64_t>(index) * interval;
+    }
+
+    // Deterministic part (trend and seasonality) at time t in O(1).
+    double at(int64_t t) const
+    {
+      const double dt = static_cast<double>(t - start);
+      double value = level + trend * dt;
+      for (const seasonal_component & s : seasonal)
+        value += s.amplitude * std::sin(detail::two_pi * dt / s.period + s.phase);
+      return value;
+    }
+  };
+
+  namespace detail {
+
+    class TimeSeriesGen
+    {
+      timeseries spec_;
+      uint64_t index_;
+      double walk_;
+      double spare_;
+      bool has_spare_;
+
+      // Box-Muller; the second value of each pair is kept for the next
+      // call so both paths below consume the same stream of normals.
+      double normal()
+      {
+        if (has_spare_)
+        {
+          has_spare_ = false;
+          return spare_;
+        }
+        const double radius = std::sqrt(-2 * std::log1p(-unit_real<double>(random_uint64())));
+        const double theta = detail::two_pi * unit_real<double>(random_uint64());
+        spare_ = radius * std::sin(theta);
+        has_spare_ = true;
+        return radius * std::cos(theta);
+      }
+
+      unsigned normals_per_point() const
+      {
+        return (spec_.noise_sigma != 0) + (spec_.walk_sigma != 0);
+      }
+
+    public:
+
+      explicit TimeSeriesGen(timeseries spec)
+        : spec_(std::move(spec)),
+          index_(0),
+          walk_(0),
+          spare_(0),
+          has_spare_(false)
+      { }
+
+      timeseries_point operator()()
+      {
+        const int64_t t = spec_.timestamp(index_++);
+        double value = spec_.at(t) + walk_;
+        if (spec_.noise_sigma != 0)
+          value += spec_.noise_sigma * normal();
+        if (spec_.walk_sigma != 0)
+          walk_ += spec_.walk_sigma * normal();
+        return timeseries_point(t, value);
+      }
+
+      // Same values as repeated operator() calls, computed block-wise:
+      // seasonal terms advance by rotating a (sin, cos) pair instead of
+      // calling sin per point, re-anchored exactly at every block start,
+      // and the other loops are free of calls so they vectorize.
+      template <class OutIter>
+      OutIter generate_n(OutIter out, size_t n)
+      {
+        constexpr size_t BLOCK = 256;
+        double values[BLOCK];
+        double normals[2 * BLOCK];
+        const unsigned draws = normals_per_point();
+        const double step = static_cast<double>(spec_.interval);
+
+        while (n > 0)
+        {
+          const size_t count = n < BLOCK ? n : BLOCK;
+          const double dt0 = static_cast<double>(spec_.timestamp(index_) - spec_.start);
+
+          for (size_t i = 0; i < count; ++i)
+            values[i] = spec_.level + spec_.trend * (dt0 + step * i);
+
+          for (const seasonal_component & s : spec_.seasonal)
+          {
+            const double angle = detail::two_pi * dt0 / s.period + s.phase;
+            const double delta = detail::two_pi * step / s.period;
+            const double sin_delta = std::sin(delta), cos_delta = std::cos(delta);
+            double sin_a = std::sin(angle), cos_a = std::cos(angle);
+            for (size_t i = 0; i < count; ++i)
+            {
+              values[i] += s.amplitude * sin_a;
+              const double next_sin = sin_a * cos_delta + cos_a * sin_delta;
+              cos_a = cos_a * cos_delta - sin_a * sin_delta;
+              sin_a = next_sin;
+            }
+          }
+
+          for (size_t i = 0; i < count * draws; ++i)
+            normals[i] = normal();
+
+          if (spec_.noise_sigma != 0)
+            for (size_t i = 0; i < count; ++i)
+              values[i] += spec_.noise_sigma * normals[i * draws];
+
+          if (spec_.walk_sigma != 0)
+          {
+            const size_t offset = draws - 1;
+            for (size_t i = 0; i < count; ++i)
+            {
+              values[i] += walk_;
+              walk_ += spec_.walk_sigma * normals[i * draws + offset];
+            }
+          }
+
+          for (size_t i = 0; i < count; ++i, ++out)
+            *out = timeseries_point(spec_.timestamp(index_ + i), values[i]);
+          index_ += count;
+          n -= count;
+        }
+        return out;
+      }
+
+      size_bounds size_hint() const
+      {
+        return size_bounds::infinite();
+      }
+
+      void save(state_writer & writer) const
+      {
+        writer.put(index_);
+        writer.put(walk_);
+        writer.put(spare_);
+        writer.put(has_spare_);
+      }
+
+      void load(state_reader & reader)
+      {
+        reader.get(index_);
+        reader.get(walk_);
+        reader.get(spare_);
+        reader.get(has_spare_);
+      }
+    };
+
+  } // namespace detail
+
+  // Infinite series of (timestamp, value) points; use take(n) to bound
+  // it. spec.at(t) gives the deterministic component of any point
+  // without generating the series.
+  auto make_timeseries_gen(timeseries spec)
+  {
+    if (spec.interval <= 0)
+      throw std::invalid_argument("timeseries: interval must be positive");
+    for (const seasonal_component & s : spec.seasonal)
+      if (!(s.period > 0))
+        throw std::invalid_argument("timeseries: seasonal period must be positive");
+    return make_gen_from(detail::TimeSeriesGen(std::move(spec)));
+  }
+
+} // namespace gen
@@ -1,5 +1,8 @@
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <numeric>
 #include <boost/core/demangle.hpp>
 
 #if _MSC_VER == 1900
@@ -15,6 +18,15 @@
 
 #include "generators/generator.h"
 #include "generators/type_generator.h"
+#include "generators/gen_sink.h"
+#include "generators/gen_check.h"
+#include "generators/constexpr_generator.h"
+#include "generators/graph_generator.h"
+#include "generators/timeseries_generator.h"
+#include "generators/markov_generator.h"
+#include "generators/pattern_generator.h"
+#include "generators/schema_generator.h"
+#include "generators/recursive_generator.h"
 
 #ifndef RANDOM_SEED
   #define RANDOM_SEED 0xAC0
@@ -122,6 +134,11 @@ std::ostream & operator << (std::ostream & o, const ShapeType & shape)
   return o;
 }
 
+auto as_tuple(const ShapeType & shape)
+{
+  return std::tie(shape.x, shape.y, shape.shapesize, shape.color);
+}
+
 auto test_shape_gen()
 {
   auto xgen = gen::make_range_gen(0, 200);
@@ -279,6 +296,1116 @@ void test_priority_n()
   std::cout << std::endl;
 }
 
+void test_sinks()
+{
+  std::ostringstream csv;
+  auto rows = gen::make_inorder_gen({ 1, 2 })
+                .map([](int i) {
+                  return std::make_tuple(i, std::string("a,\"b\""),
+                                         boost::optional<double>());
+                });
+  gen::sink_options opts;
+  opts.field_names = { "id", "name", "score" };
+  assert(gen::to_csv(rows, csv, opts) == 2);
+  assert(csv.str() == "id,name,score\n"
+                      "1,\"a,\"\"b\"\"\",\n"
+                      "2,\"a,\"\"b\"\"\",\n");
+
+  std::ostringstream jsonl;
+  auto shapes = gen::make_inorder_gen({ 1, 2, 3 })
+                  .map([](int i) {
+                    return ShapeType { i, 2 * i, 30, "RED" };
+                  });
+  opts.field_names = { "x", "y", "size", "color" };
+  opts.pipelined = true;
+  opts.buffer_size = 16;
+  assert(gen::to_jsonl(shapes, jsonl, opts) == 3);
+  assert(jsonl.str() ==
+         "{\"x\":1,\"y\":2,\"size\":30,\"color\":\"RED\"}\n"
+         "{\"x\":2,\"y\":4,\"size\":30,\"color\":\"RED\"}\n"
+         "{\"x\":3,\"y\":6,\"size\":30,\"color\":\"RED\"}\n");
+
+  std::ostringstream vecs;
+  opts = gen::sink_options();
+  opts.max_records = 2;
+  auto vecgen = gen::make_constant_gen(std::vector<int> { 1, 2 });
+  assert(gen::to_jsonl(vecgen, vecs, opts) == 2);
+  assert(vecs.str() == "[1,2]\n[1,2]\n");
+
+  // fields longer than the buffer while the writer thread is busy
+  std::ostringstream longs;
+  opts = gen::sink_options();
+  opts.pipelined = true;
+  opts.buffer_size = 64;
+  auto longgen = gen::make_stepper_gen(1, 40).map([](int i) {
+    return std::make_tuple(i, std::string(i * 10, 'x'));
+  });
+  assert(gen::to_csv(longgen, longs, opts) == 40);
+  std::string expected;
+  for (int i = 1; i <= 40; ++i)
+    expected += std::to_string(i) + "," + std::string(i * 10, 'x') + "\n";
+  assert(longs.str() == expected);
+}
+
+void test_columns()
+{
+  auto shapegen =
+    gen::make_zip_gen(
+      [](int x, int y, int size, const char * color) {
+          return ShapeType { x, y, size, color };
+      },
+      gen::make_range_gen(0, 200),
+      gen::make_stepper_gen(),
+      gen::make_constant_gen(30),
+      gen::make_oneof_gen({ "RED", "GREEN", "BLUE" }));
+
+  auto cols = shapegen.generate_columns(100);
+  assert(std::get<0>(cols).size() == 100);
+  assert(std::get<1>(cols)[99] == 99);
+  assert(std::get<2>(cols)[50] == 30);
+
+  auto shapes = shapegen.generate_batch(100);
+  assert(shapes.size() == 100);
+  assert(shapes[0].y == 100 && shapes[99].y == 199);
+  for (auto & shape : shapes)
+    assert(shape.x >= 0 && shape.x < 200 && shape.shapesize == 30);
+
+  auto tuplegen = gen::make_composed_gen(gen::make_stepper_gen(),
+                                         gen::make_constant_gen('a'));
+  auto tuples = tuplegen.generate_batch(3);
+  assert(tuples[2] == std::make_tuple(2, 'a'));
+
+  auto zipgen = gen::make_stepper_gen()
+                  .zip_with([](int i, int j) { return i + j; },
+                            gen::make_stepper_gen(10));
+  auto sums = std::get<1>(zipgen.generate_columns(2));
+  assert(sums[0] == 10 && sums[1] == 11);
+
+  // fields draw from the engine in the same order on every path
+  auto randgen = gen::make_composed_gen(gen::make_range_gen(0, 1000000),
+                                        gen::make_range_gen(0, 1000000));
+  gen::initialize(3);
+  auto scalar = randgen.generate();
+  gen::initialize(3);
+  std::tuple<int, int> inplace;
+  randgen.generate_into(inplace);
+  gen::initialize(3);
+  auto batch = randgen.generate_batch(1);
+  assert(scalar == inplace && scalar == batch[0]);
+}
+
+auto make_checkpointed_pipeline()
+{
+  return gen::make_inorder_gen({ 3, 1, 4, 1, 5 })
+           .concat_map([](int i) { return gen::make_stepper_gen(1, i); })
+           .concat(gen::make_stepper_gen(100).take(5))
+           .zip_with([](int i, int r) { return i * 1000 + r; },
+                     gen::make_range_gen(0, 1000));
+}
+
+void test_snapshot()
+{
+  gen::initialize(42);
+  auto pipeline = make_checkpointed_pipeline();
+  for (int i = 0; i < 7; ++i)
+    pipeline.generate();
+
+  std::string state = pipeline.snapshot();
+  auto expected = pipeline.to_vector();
+  assert(expected.size() == 12);
+
+  auto resumed = make_checkpointed_pipeline();
+  resumed.restore(state);
+  assert(resumed.to_vector() == expected);
+
+  bool rejected = false;
+  try {
+    gen::make_stepper_gen().restore(state);
+  }
+  catch (std::invalid_argument &) {
+    rejected = true;
+  }
+  assert(rejected);
+}
+
+void test_check()
+{
+  auto vecgen = gen::GenFactory<std::vector<int>>::make(
+                  gen::make_range_gen(0, 1000), 20, true);
+
+  auto sorted = gen::check(vecgen, [](std::vector<int> v) {
+    std::sort(v.begin(), v.end());
+    return std::is_sorted(v.begin(), v.end());
+  }, 20000, 4);
+  assert(sorted.passed && sorted.cases == 20000);
+
+  auto no_big_sums = [](const std::vector<int> & v) {
+    return std::accumulate(v.begin(), v.end(), 0) < 12000;
+  };
+  auto serial   = gen::check(vecgen, no_big_sums, 100000, 1, 7);
+  auto parallel = gen::check(vecgen, no_big_sums, 100000, 4, 7);
+  assert(!serial.passed);
+  assert(serial.failed_case == parallel.failed_case);
+  assert(serial.seed == parallel.seed);
+  assert(gen::replay(vecgen, parallel.seed) == *parallel.counterexample);
+  assert(!no_big_sums(*parallel.counterexample));
+
+  // the end of a finite generator is not a counterexample
+  auto finite = gen::check(gen::make_stepper_gen(0, 99), [](int) { return true; }, 1000, 1);
+  assert(finite.passed && finite.cases == 100);
+
+  // positional generators give the same cases on any number of threads
+  auto stepper = gen::make_stepper_gen(0, 1999);
+  auto all_pass = gen::check(stepper, [](int) { return true; }, 5000, 4);
+  assert(all_pass.passed && all_pass.cases == 2000);
+  auto below = gen::check(stepper, [](int v) { return v < 1500; }, 5000, 4);
+  assert(!below.passed && below.failed_case == 1500 && *below.counterexample == 1500);
+  assert(gen::replay(stepper, below) == 1500);
+  assert(gen::replay(vecgen, parallel) == *parallel.counterexample);
+
+  std::atomic<unsigned> ran(0);
+  try {
+    gen::detail::parallel_for(4, [&ran](unsigned worker) {
+      ++ran;
+      if (worker == 0)
+        throw std::runtime_error("worker 0");
+    });
+    assert(false);
+  }
+  catch (std::runtime_error &) {
+    assert(ran == 4);
+  }
+}
+
+void test_constexpr_gen()
+{
+  constexpr auto seeds =
+    gen::cx::to_array<16>(gen::cx::make_range_gen(100u, 200u, 0xAC0));
+  static_assert(seeds[0] >= 100 && seeds[0] < 200, "");
+  static_assert(seeds[15] >= 100 && seeds[15] < 200, "");
+
+  constexpr auto steps =
+    gen::cx::to_array<4>(gen::make_stepper_gen(10, 100, 5).take(4)
+                           .map([](int i) { return i * 2; }));
+  static_assert(steps[0] == 20 && steps[3] == 50, "");
+
+  constexpr auto colors =
+    gen::cx::to_array<8>(gen::cx::make_oneof_gen(std::array<char, 3> { 'R', 'G', 'B' }, 7));
+  static_assert(colors[5] == 'R' || colors[5] == 'G' || colors[5] == 'B', "");
+
+  constexpr auto grid =
+    gen::make_array_gen(gen::cx::make_range_gen(0, 10, 1),
+                        gen::dim_list<2, 3>()).generate();
+  static_assert(grid[1][2] >= 0 && grid[1][2] < 10, "");
+
+  auto runtime = gen::cx::make_range_gen(100u, 200u, 0xAC0);
+  for (auto seed : seeds)
+    assert(seed == runtime.generate());
+
+  bool rejected = false;
+  try {
+    gen::cx::make_range_gen(5, 5, 1);
+  }
+  catch (std::invalid_argument &) {
+    rejected = true;
+  }
+  assert(rejected);
+}
+
+void test_generate_into()
+{
+  auto recgen =
+    gen::make_composed_gen(
+      gen::make_seq_gen<std::vector>(gen::make_string_gen(gen::make_alpha_gen(), 8), 4),
+      gen::make_pair_gen(gen::make_stepper_gen(), gen::make_string_gen(gen::make_digit_gen(), 8)),
+      gen::make_optional_gen(gen::make_string_gen(gen::make_printable_gen(), 8)));
+
+  std::tuple<std::vector<std::string>,
+             std::pair<int, std::string>,
+             boost::optional<std::string>> rec;
+  auto & words = std::get<0>(rec);
+  words.reserve(4);
+  words.resize(4);
+  for (auto & word : words)
+    word.reserve(32);
+  std::get<1>(rec).second.reserve(32);
+
+  const void * words_data = words.data();
+  const void * word_data = words[0].data();
+  const void * digits_data = std::get<1>(rec).second.data();
+
+  for (int i = 0; i < 100; ++i)
+  {
+    recgen.generate_into(rec);
+    assert(words.size() >= 1 && words.size() <= 4);
+    assert(words.data() == words_data);
+    assert(words[0].data() == word_data);
+    assert(std::get<1>(rec).first == i);
+    assert(std::get<1>(rec).second.data() == digits_data);
+  }
+
+  auto listgen = gen::GenFactory<std::list<int>>::make();
+  std::list<int> list;
+  listgen.generate_into(list);
+  assert(!list.empty());
+
+  // proxy references and elements without a default constructor are
+  // appended one by one instead of regenerated in place
+  std::vector<bool> flags = gen::GenFactory<std::vector<bool>>::make().generate();
+  assert(!flags.empty());
+
+  struct label
+  {
+    explicit label(int n) : n(n) {}
+    int n;
+  };
+  auto labels = gen::make_seq_gen<std::vector>(
+                  gen::make_stepper_gen().map([](int n) { return label(n); }), 5).generate();
+  assert(!labels.empty() && labels[0].n == 0);
+}
+
+void test_charset_gen()
+{
+  auto check_charset = [](auto chargen, const std::string & charset) {
+    std::string text(4000, '\0');
+    chargen.generate_n(&text[0], text.size());
+    for (int i = 0; i < 100; ++i)
+      text.push_back(chargen.generate());
+
+    for (char ch : text)
+      assert(charset.find(ch) != std::string::npos);
+    for (char ch : charset)
+      assert(text.find(ch) != std::string::npos);
+  };
+
+  check_charset(gen::make_charset_gen("xyz"), "xyz");
+  check_charset(gen::make_hex_gen(), "0123456789abcdef");
+  check_charset(gen::make_digit_gen(), "0123456789");
+  check_charset(gen::make_alphanum_gen(),
+                "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789");
+
+  auto idgen = gen::make_string_gen(gen::make_hex_gen(), 40);
+  for (int i = 0; i < 100; ++i)
+  {
+    auto id = idgen.generate();
+    assert(id.size() >= 1 && id.size() <= 40);
+    assert(id.find_first_not_of("0123456789abcdef") == std::string::npos);
+  }
+}
+
+void test_real_gen()
+{
+  auto unit = gen::GenFactory<double>::make();
+  std::vector<double> samples(10000);
+  unit.generate_n(samples.begin(), samples.size());
+  double sum = 0;
+  for (double d : samples)
+  {
+    assert(d >= 0.0 && d < 1.0);
+    sum += d;
+  }
+  assert(sum / samples.size() > 0.45 && sum / samples.size() < 0.55);
+
+  auto fgen = gen::GenFactory<float>::make();
+  for (int i = 0; i < 1000; ++i)
+  {
+    float f = fgen.generate();
+    assert(f >= 0.0f && f < 1.0f);
+  }
+
+  auto uniform = gen::make_uniform_real_gen(-5.0f, 5.0f);
+  for (int i = 0; i < 1000; ++i)
+  {
+    float f = uniform.generate();
+    assert(f >= -5.0f && f < 5.0f);
+  }
+
+  auto loggen = gen::make_log_uniform_gen(1e-3, 1e3);
+  int below_one = 0;
+  for (int i = 0; i < 1000; ++i)
+  {
+    double d = loggen.generate();
+    assert(d >= 1e-3 && d < 1e3);
+    below_one += d < 1.0;
+  }
+  assert(below_one > 400 && below_one < 600);
+
+  // ranges whose width overflows, and log ranges whose ends round
+  const double dmax = std::numeric_limits<double>::max();
+  auto widest = gen::make_uniform_real_gen(-dmax, dmax);
+  int negative = 0;
+  for (int i = 0; i < 1000; ++i)
+  {
+    double d = widest.generate();
+    assert(std::isfinite(d) && d >= -dmax && d < dmax);
+    negative += d < 0;
+  }
+  assert(negative > 400 && negative < 600);
+
+  const double lo = 3.0 / 997;  // exp(log(lo)) < lo
+  auto narrow = gen::make_log_uniform_gen(lo, std::nextafter(lo, 1.0));
+  for (int i = 0; i < 1000; ++i)
+    assert(narrow.generate() == lo);
+
+  auto bitsgen = gen::make_float_bits_gen<double>();
+  std::vector<double> patterns = bitsgen.generate_batch(10000);
+  assert(std::any_of(patterns.begin(), patterns.end(),
+                     [](double d) { return d < 0; }));
+}
+
+void test_parallel_reduce()
+{
+  auto plus = [](int64_t acc, int64_t val) { return acc + val; };
+  auto steps = gen::make_stepper_gen(1);
+  assert(steps.parallel_reduce(1000000, plus, int64_t(0), 1) == 500000500000LL);
+  assert(steps.parallel_reduce(1000000, plus, int64_t(0), 4) == 500000500000LL);
+
+  auto finite = gen::make_stepper_gen(1, 100000)
+                  .concat(gen::make_stepper_gen(1, 100000));
+  assert(finite.parallel_reduce(500000, plus, int64_t(0), 3) == 2 * 5000050000LL);
+
+  auto cycle = gen::make_stepper_gen(0, 4, 2, true);
+  cycle.skip(4);
+  assert(cycle.generate() == 2);
+  cycle.skip(1);
+  assert(cycle.generate() == 0);
+
+  auto checksum = [](uint64_t acc, uint64_t val) {
+    return acc ^ (val * 0x9e3779b97f4a7c15ULL);
+  };
+  auto values = gen::make_range_gen(0, 1 << 30)
+                  .map([](int i) { return static_cast<uint64_t>(i); });
+  gen::initialize(11);
+  auto serial = values.parallel_reduce(300000, checksum, uint64_t(0), 1);
+  gen::initialize(11);
+  auto parallel = values.parallel_reduce(300000, checksum, uint64_t(0), 8);
+  assert(serial == parallel);
+
+  // a reducer throwing on a worker thread reaches the caller
+  bool propagated = false;
+  try {
+    steps.parallel_reduce(1000000, [](int64_t acc, int64_t val) {
+      if (val == 900000)
+        throw std::runtime_error("bad value");
+      return acc + val;
+    }, int64_t(0), 4);
+  }
+  catch (std::runtime_error &) {
+    propagated = true;
+  }
+  assert(propagated);
+}
+
+void test_size_hint()
+{
+  auto inorder = gen::make_inorder_gen({ 1, 2, 3, 4 });
+  assert(inorder.size_hint().is_exact() && inorder.size_hint().upper == 4);
+  inorder.generate();
+  assert(inorder.size_hint().upper == 3);
+
+  auto concat = gen::make_stepper_gen(0, 9)
+                  .concat(gen::make_single_gen(42))
+                  .map([](int i) { return i * 2; });
+  assert(concat.size_hint().is_exact() && concat.size_hint().upper == 11);
+
+  auto zipped = gen::make_stepper_gen(0, 99)
+                  .zip_with([](int i, int j) { return i + j; },
+                            gen::make_stepper_gen().take(50));
+  assert(zipped.size_hint().upper == 50);
+
+  auto infinite = gen::make_stepper_gen(0, 10, 1, true);
+  assert(infinite.size_hint().lower == gen::size_bounds::unbounded);
+  auto taken = gen::make_stepper_gen().take(1000);
+  assert(taken.size_hint().upper == 1000);
+
+  auto lown = gen::make_lowest_n_gen(gen::make_stepper_gen(1).take(100), 10);
+  assert(lown.size_hint().upper == 10);
+
+  auto v = gen::make_stepper_gen().take(1000).to_vector();
+  assert(v.size() == 1000 && v.capacity() == 1000);
+
+  // a finite element source ends the sequences instead of emptying them
+  auto seqs = gen::make_seq_gen<std::vector>(
+                gen::make_inorder_gen({ 1, 2, 3, 4, 5, 6, 7 }), 3).to_vector();
+  size_t elements = 0;
+  for (const auto & seq : seqs)
+  {
+    assert(!seq.empty());
+    elements += seq.size();
+  }
+  assert(seqs.size() >= 2 && elements <= 7);
+}
+
+void test_vocab_gen()
+{
+  std::vector<std::string> cities { "Paris", "Lima", "Oslo", "Nairobi", "Hanoi" };
+  auto citygen = gen::make_vocab_gen(cities);
+  auto copy = citygen;
+  for (int i = 0; i < 100; ++i)
+  {
+    std::string_view city = copy.generate();
+    assert(std::find(cities.begin(), cities.end(), city) != cities.end());
+  }
+
+  gen::vocabulary vocab { "red", "green", "blue" };
+  std::vector<uint32_t> codes(1001);
+  gen::make_vocab_index_gen(vocab).generate_n(codes.begin(), codes.size());
+  for (auto code : codes)
+    assert(code < vocab.size());
+  assert(std::count(codes.begin(), codes.end(), 2u) > 200);
+  assert(vocab[1] == "green");
+
+  auto refgen = gen::make_oneof_ref_gen(std::vector<std::string> { "x", "y" });
+  const std::string & ref = refgen.generate();
+  assert(ref == "x" || ref == "y");
+  static_assert(std::is_same<decltype(refgen)::value_type,
+                             std::reference_wrapper<const std::string>>::value, "");
+  bool rejected = false;
+  try {
+    gen::make_oneof_ref_gen(std::vector<int> {});
+  }
+  catch (std::invalid_argument &) {
+    rejected = true;
+  }
+  assert(rejected);
+
+  std::ostringstream csv;
+  gen::sink_options opts;
+  opts.max_records = 3;
+  gen::to_csv(gen::make_vocab_gen(std::vector<std::string> { "only" }), csv, opts);
+  assert(csv.str() == "only\nonly\nonly\n");
+}
+
+void test_graph_gen()
+{
+  const uint64_t n = 2000;
+  auto complete = gen::make_erdos_renyi_gen(10, 1.0).to_vector();
+  assert(complete.size() == 45);
+  assert(gen::make_erdos_renyi_gen(10, 0.0).to_vector().empty());
+
+  size_t total = 0;
+  for (unsigned shard = 0; shard < 4; ++shard)
+  {
+    auto edges = gen::make_erdos_renyi_gen(n, 0.01, false, shard, 4).to_vector();
+    for (auto & e : edges)
+      assert(e.second < e.first && e.first < n);
+    total += edges.size();
+  }
+  const double expected = 0.01 * n * (n - 1) / 2;
+  assert(std::abs(total - expected) < 0.1 * expected);
+
+  for (auto & e : gen::make_erdos_renyi_gen(50, 0.2, true).to_vector())
+    assert(e.first != e.second && e.second < 50);
+
+  // sparse graphs reserve for their edges, not their candidates
+  auto sparse = gen::make_erdos_renyi_gen(200000, 1e-5).to_vector();
+  assert(sparse.size() > 150000 && sparse.size() < 250000);
+  auto huge = gen::make_erdos_renyi_gen(uint64_t(1) << 40, 1e-300, true);
+  assert(huge.size_hint().upper == gen::size_bounds::unbounded);
+  assert(huge.to_vector().empty());
+
+  for (auto & e : gen::make_rmat_gen(10).take(1000).to_vector())
+    assert(e.first < 1024 && e.second < 1024);
+
+  auto bagen = gen::make_barabasi_albert_gen(500, 3);
+  assert(bagen.size_hint().is_exact() && bagen.size_hint().lower == 497 * 3);
+  std::vector<size_t> degree(500);
+  for (auto & e : bagen.to_vector())
+  {
+    assert(e.second < e.first);
+    ++degree[e.first];
+    ++degree[e.second];
+  }
+  assert(*std::max_element(degree.begin(), degree.end()) > 20);
+}
+
+void test_timeseries_gen()
+{
+  gen::timeseries spec;
+  spec.start = 1000;
+  spec.interval = 60;
+  spec.level = 10;
+  spec.trend = 0.001;
+  spec.seasonal.push_back({ 3600, 2.0 });
+  spec.seasonal.push_back({ 86400, 5.0, 1.0 });
+
+  std::vector<gen::timeseries_point> points(1000);
+  gen::make_timeseries_gen(spec).generate_n(points.begin(), points.size());
+  for (size_t i = 0; i < points.size(); ++i)
+  {
+    assert(points[i].first == 1000 + 60 * static_cast<int64_t>(i));
+    assert(std::abs(points[i].second - spec.at(points[i].first)) < 1e-9);
+  }
+
+  spec.walk_sigma = 0.5;
+  spec.noise_sigma = 0.1;
+  auto tsgen = gen::make_timeseries_gen(spec);
+  auto state = tsgen.snapshot();
+  std::vector<gen::timeseries_point> batch(700);
+  tsgen.generate_n(batch.begin(), batch.size());
+  tsgen.restore(state);
+  for (auto & point : batch)
+  {
+    auto scalar = tsgen.generate();
+    assert(scalar.first == point.first);
+    assert(std::abs(scalar.second - point.second) < 1e-9);
+  }
+}
+
+void test_markov_text_gen()
+{
+  auto cyclic = gen::make_markov_text_gen("abcabcabcabc", 2, 30);
+  std::string text = cyclic.generate();
+  assert(text.size() == 30);
+  for (size_t i = 1; i < text.size(); ++i)
+    assert(text[i] == "abc"[(text[i - 1] - 'a' + 1) % 3]);
+
+  const std::string corpus = "the cat sat on the mat and the rat sat on the hat";
+  auto model = std::make_shared<const gen::markov_model>(corpus, 3);
+  std::stringstream file;
+  model->save(file);
+  auto loaded = std::make_shared<const gen::markov_model>(gen::markov_model::load(file));
+  assert(loaded->states() == model->states());
+
+  gen::initialize(7);
+  std::string original = gen::make_markov_text_gen(model, 200).generate();
+  gen::initialize(7);
+  std::string buffer;
+  gen::make_markov_text_gen(loaded, 200).generate_into(buffer);
+  assert(original == buffer);
+  for (size_t i = 0; i + 4 <= buffer.size(); ++i)
+    assert((corpus + corpus.substr(0, 3)).find(buffer.substr(i, 4)) != std::string::npos);
+
+  // truncated and corrupted files are rejected instead of read past
+  const std::string saved = file.str();
+  std::vector<std::string> bad { saved.substr(0, saved.size() / 2), saved };
+  const size_t last_alias = saved.size() - sizeof(uint32_t);
+  bad[1].replace(last_alias, 4, 4, '\x7f');  // start table alias far past the states
+  for (const std::string & blob : bad)
+  {
+    std::istringstream in(blob);
+    bool rejected = false;
+    try {
+      gen::markov_model::load(in);
+    }
+    catch (std::runtime_error &) {
+      rejected = true;
+    }
+    assert(rejected);
+  }
+}
+
+void test_pattern_gen()
+{
+  auto idgen = gen::make_pattern_gen("[A-Z]{3}-[0-9]{4}");
+  std::string id;
+  for (int i = 0; i < 100; ++i)
+  {
+    idgen.generate_into(id);
+    assert(id.size() == 8 && id[3] == '-');
+    for (int j : { 0, 1, 2 })
+      assert(std::isupper(static_cast<unsigned char>(id[j])));
+    for (int j : { 4, 5, 6, 7 })
+      assert(std::isdigit(static_cast<unsigned char>(id[j])));
+  }
+
+  auto mixed = gen::make_pattern_gen("ab?c*\\d\\.[^a-z]{2,3}x+", 4);
+  for (int i = 0; i < 100; ++i)
+  {
+    std::string s = mixed.generate();
+    assert(s[0] == 'a');
+    size_t pos = 1;
+    if (s[pos] == 'b')
+      ++pos;
+    while (s[pos] == 'c')
+      ++pos;
+    assert(std::isdigit(static_cast<unsigned char>(s[pos])) && s[pos + 1] == '.');
+    pos += 2;
+    size_t run = 0;
+    for (; s[pos] != 'x'; ++pos, ++run)
+      assert(!std::islower(static_cast<unsigned char>(s[pos])));
+    assert(run >= 2 && run <= 3);
+    assert(s.size() - pos >= 1 && s.size() - pos <= 5);
+    assert(s.find_first_not_of('x', pos) == std::string::npos);
+  }
+
+  try {
+    gen::make_pattern_gen("[a-");
+    assert(false);
+  }
+  catch (const std::invalid_argument &) { }
+}
+
+void test_schema_gen()
+{
+  using namespace gen::schema;
+  auto batchgen = gen::make_schema_gen({
+      integer(gen::field_kind::int32, "id", 1, 100),
+      real(gen::field_kind::float64, "score", 0, 10),
+      string("name", 8, "ab"),
+      vector("tags", integer(gen::field_kind::uint8, "tag", 0, 3), 4, true),
+      optional("parent", integer(gen::field_kind::int64, "id"), 0.25),
+      array("point", real(gen::field_kind::float32, "coord"), 3),
+      tuple("pair", { boolean("flag"), character("grade", "ABCDF") })
+    }, 1000);
+
+  gen::record_batch batch;
+  batchgen.generate_into(batch);
+  assert(batch.rows == 1000 && batch.columns.size() == 7);
+
+  const int32_t * ids = batch["id"].values<int32_t>();
+  const double * scores = batch["score"].values<double>();
+  for (size_t i = 0; i < batch.rows; ++i)
+    assert(ids[i] >= 1 && ids[i] <= 100 && scores[i] >= 0 && scores[i] < 10);
+
+  const gen::column & names = batch["name"];
+  for (size_t i = 0; i < batch.rows; ++i)
+  {
+    std::string_view name = names.text(i);
+    assert(name.size() >= 1 && name.size() <= 8);
+    assert(name.find_first_not_of("ab") == std::string_view::npos);
+  }
+
+  const gen::column & tags = batch["tags"];
+  assert(tags.children[0].rows == tags.offsets.back());
+  for (size_t i = 0; i < tags.children[0].rows; ++i)
+    assert(tags.children[0].values<uint8_t>()[i] <= 3);
+
+  const gen::column & parent = batch["parent"];
+  size_t nulls = std::count(parent.valid.begin(), parent.valid.end(), 0);
+  assert(nulls > 150 && nulls < 350);
+  assert(batch["point"].children[0].rows == 3000);
+
+  const gen::column & pair = batch["pair"];
+  for (size_t i = 0; i < pair.rows; ++i)
+    assert(std::string("ABCDF").find(pair.children[1].values<char>()[i]) != std::string::npos);
+
+  batchgen.generate_into(batch);
+  assert(batch["id"].values<int32_t>() == ids);  // buffers are reused
+
+  try {
+    gen::make_schema_gen({ vector("bad", string("s"), 0) }, 1);
+    assert(false);
+  }
+  catch (const std::invalid_argument &) { }
+}
+
+void test_random_schema()
+{
+  // more members than the first replacement generation holds
+  for (unsigned seed = 1; seed <= 20; ++seed)
+  {
+    gen::initialize(seed);
+    std::vector<gen::field> wide = gen::random_schema(100, 1);
+    std::vector<std::string> names;
+    for (const gen::field & f : wide)
+      names.push_back(gen::type_name(f));
+    std::sort(names.begin(), names.end());
+    assert(names.size() == 100 && std::unique(names.begin(), names.end()) == names.end());
+  }
+
+  gen::initialize(3);
+  auto first = gen::random_schema();
+  gen::initialize(3);
+  auto again = gen::random_schema();
+  assert(first.size() == 24);
+
+  std::vector<std::string> types;
+  for (size_t i = 0; i < first.size(); ++i)
+  {
+    types.push_back(gen::type_name(first[i]));
+    assert(types.back() == gen::type_name(again[i]));
+  }
+  std::sort(types.begin(), types.end());
+  assert(std::unique(types.begin(), types.end()) == types.end());
+
+  auto schemagen = gen::make_random_schema_gen(8, 2);
+  for (int i = 0; i < 200; ++i)
+  {
+    gen::schema_plan plan(schemagen.generate());
+    gen::record_batch batch = plan.generate(16);
+    assert(batch.columns.size() == 8);
+    for (const gen::column & col : batch.columns)
+      assert(col.rows == 16);
+  }
+}
+
+void test_byte_entropy()
+{
+  const unsigned char input[] = { 7, 200, 1, 0x34, 0x12, 5 };
+  {
+    gen::byte_entropy bytes(input, sizeof(input));
+    assert(gen::make_range_gen(0, 10).generate() == 7);
+    assert(gen::make_range_gen(0, 256).generate() == 200);
+    assert(gen::GenFactory<bool>::make().generate());
+    assert(gen::make_range_gen(0, 65536).generate() == 0x1234);
+    assert(bytes.consumed() == 5);
+
+    auto seq = gen::make_seq_gen<std::vector>(gen::make_range_gen(0, 100), 10).generate();
+    assert(seq.size() == 6 && seq[0] == 0);  // 5 % 10 + 1 elements, then zeros
+    assert(bytes.exhausted());
+    assert(gen::make_oneof_gen({ 'a', 'b', 'c' }).generate() == 'a');
+    assert(gen::make_string_gen(gen::make_alpha_gen()).generate() == "a");
+
+    // all-zero draws still give distinct member types
+    std::vector<gen::field> schema = gen::random_schema(24, 2);
+    assert(schema.size() == 24);
+    std::vector<std::string> types;
+    for (const gen::field & f : schema)
+      types.push_back(gen::type_name(f));
+    std::sort(types.begin(), types.end());
+    assert(std::unique(types.begin(), types.end()) == types.end());
+    gen::schema_plan(gen::random_schema(4, 0)).generate(4);
+    assert(gen::random_schema(200, 2).size() == 200);
+  }
+
+  // a reused character generator keeps nothing from earlier inputs
+  auto alpha = gen::make_alpha_gen();
+  alpha.generate();
+  const unsigned char one[] = { 1, 2 };
+  for (int i = 0; i < 3; ++i)
+  {
+    gen::byte_entropy bytes(one, sizeof(one));
+    assert(alpha.generate() == 'b' && bytes.consumed() == 1);
+    char pair[2];
+    alpha.generate_n(pair, 2);
+    assert(pair[0] == 'c' && bytes.exhausted());
+  }
+
+  gen::initialize(1);
+  int first = gen::random_int32();
+  gen::initialize(1);
+  {
+    gen::byte_entropy bytes(input, 0);
+    assert(gen::random_int32() == 0);
+  }
+  assert(gen::random_int32() == first);
+
+  bool rejected = false;
+  try {
+    gen::random_below(0);
+  }
+  catch (std::invalid_argument &) {
+    rejected = true;
+  }
+  assert(rejected);
+}
+
+struct TreeNode
+{
+  static int live;
+  std::string label;
+  std::vector<TreeNode *> children;
+
+  TreeNode() { ++live; }
+  ~TreeNode() { --live; }
+};
+
+int TreeNode::live = 0;
+
+size_t count_nodes(const TreeNode * node)
+{
+  size_t count = 1;
+  for (const TreeNode * child : node->children)
+    count += count_nodes(child);
+  return count;
+}
+
+void test_recursive_gen()
+{
+  unsigned int max_depth = 0;
+  auto treegen = gen::make_recursive_gen<TreeNode *>(
+    [&max_depth](auto & recurse, size_t budget) {
+      max_depth = std::max(max_depth, recurse.depth());
+      TreeNode * node = recurse.template make<TreeNode>();
+      node->label = "node";
+      size_t parts[3];
+      gen::split_budget(budget - 1, 3, parts);
+      for (size_t part : parts)
+        if (part > 0)
+          node->children.push_back(recurse(part));
+      return node;
+    }, 200);
+
+  gen::arena_tree<TreeNode *> tree;
+  for (int i = 0; i < 10; ++i)
+  {
+    treegen.generate_into(tree);
+    assert(count_nodes(tree.root) == 200);
+    assert(TreeNode::live == 200);
+  }
+  assert(max_depth > 3);
+  tree.reset();
+  assert(TreeNode::live == 0);
+
+  {
+    gen::arena nodes;
+    int * ints = nodes.make<int>(42);
+    assert(*ints == 42);
+    nodes.make<TreeNode>();
+    assert(TreeNode::live == 1);
+  }
+  assert(TreeNode::live == 0);
+}
+
+void test_frequency_gen()
+{
+  auto freqgen = gen::make_frequency_gen(std::make_pair(6, gen::make_range_gen(0, 10)),
+                                         std::make_pair(3, gen::make_range_gen(100, 101)),
+                                         std::make_pair(1, gen::make_stepper_gen(1000, 2000, 1, true)));
+  std::vector<int> values(10000);
+  freqgen.generate_n(values.begin(), 5000);
+  for (size_t i = 5000; i < values.size(); ++i)
+    values[i] = freqgen.generate();
+
+  size_t counts[3] = {};
+  for (int v : values)
+    ++counts[v < 10 ? 0 : v == 100 ? 1 : 2];
+  assert(counts[0] > 5700 && counts[0] < 6300);
+  assert(counts[1] > 2700 && counts[1] < 3300);
+  assert(counts[2] > 850 && counts[2] < 1150);
+
+  // the stepper branch still steps in order across batches
+  std::vector<int> stepped;
+  std::copy_if(values.begin(), values.end(), std::back_inserter(stepped),
+               [](int v) { return v >= 1000; });
+  for (size_t i = 1; i < stepped.size(); ++i)
+    assert(stepped[i] == stepped[i - 1] + 1);
+}
+
+class counting_resource : public std::pmr::memory_resource
+{
+public:
+  size_t allocations = 0;
+
+private:
+  void * do_allocate(size_t bytes, size_t align) override
+  {
+    ++allocations;
+    return std::pmr::new_delete_resource()->allocate(bytes, align);
+  }
+
+  void do_deallocate(void * p, size_t bytes, size_t align) override
+  {
+    std::pmr::new_delete_resource()->deallocate(p, bytes, align);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource & other) const noexcept override
+  {
+    return this == &other;
+  }
+};
+
+void test_pooled_factories()
+{
+  counting_resource upstream;
+  gen::arena pool(1 << 16, &upstream);
+  {
+    gen::arena_scope scope(pool);
+    auto ptrgen = gen::GenFactory<std::vector<int> *>::make();
+    auto sharedgen = gen::GenFactory<std::shared_ptr<int64_t>>::make();
+    std::vector<std::vector<int> *> ptrs;
+    std::vector<std::shared_ptr<int64_t>> shared;
+    for (int i = 0; i < 500; ++i)
+    {
+      ptrs.push_back(ptrgen.generate());
+      shared.push_back(sharedgen.generate());
+    }
+    assert(!ptrs.back()->empty() && shared.back().use_count() == 1);
+    assert(upstream.allocations < 10);  // a few large blocks, not 1000 objects
+  }
+  pool.release();
+
+  int * heap = gen::GenFactory<int *>::make().generate();  // no scope: plain new
+  delete heap;
+}
+
+struct MoveOnlyCounter
+{
+  std::unique_ptr<int> next = std::make_unique<int>(0);
+
+  int operator()() { return (*next)++; }
+};
+
+void test_borrow_share()
+{
+  auto vocabgen = gen::make_vocab_gen(std::vector<std::string> { "x", "y", "z" });
+  auto pairgen = gen::make_pair_gen(gen::borrow(vocabgen), gen::borrow(vocabgen));
+  assert(sizeof(pairgen) <= 3 * sizeof(void *));  // two pointers and the empty combiner
+  auto pair = pairgen.generate();
+  assert(pair.first.size() == 1 && pair.second.size() == 1);
+
+  auto counter = gen::share(gen::make_stepper_gen());
+  auto copy = counter;
+  assert(counter.generate() == 0);
+  assert(copy.generate() == 1);
+  assert(counter.generate() == 2);
+  static_assert(decltype(counter)::shares_state, "kept off the parallel paths");
+  static_assert(!decltype(vocabgen)::shares_state, "");
+
+  auto stepper = gen::make_stepper_gen();
+  auto borrowed = gen::make_seq_gen<std::vector>(gen::borrow(stepper), 3);
+  auto seq = borrowed.generate();
+  assert(seq.front() == 0 && stepper.generate() == static_cast<int>(seq.size()));
+
+  auto moveonly = gen::make_gen_from(MoveOnlyCounter())
+                    .map([](int i) { return i * 2; })
+                    .take(5);
+  auto arrays = gen::make_array_gen(std::move(moveonly), gen::dim_list<2, 2>());
+  auto arr = arrays.generate();
+  assert(arr[0][0] == 0 && arr[1][1] == 6);
+}
+
+void test_chunk_window()
+{
+  auto chunks = gen::make_stepper_gen(0, 9).chunk(4);
+  auto first = chunks.generate();
+  const int * buffer = first.data();
+  assert(first.size() == 4 && first[0] == 0 && first[3] == 3);
+  auto second = chunks.generate();
+  assert(second.data() == buffer && second[0] == 4);
+  assert(chunks.generate().size() == 2);
+  try {
+    chunks.generate();
+    assert(false);
+  }
+  catch (std::out_of_range &) { }
+
+  auto windows = gen::make_stepper_gen(0, 9).window(3, 2);
+  assert(windows.size_hint().upper == 4);
+  std::vector<std::vector<int>> seen;
+  for (auto w : windows)
+    seen.emplace_back(w.begin(), w.end());
+  assert((seen == std::vector<std::vector<int>> { { 0, 1, 2 }, { 2, 3, 4 }, { 4, 5, 6 }, { 6, 7, 8 } }));
+
+  size_t rows = 0, calls = 0;
+  gen::make_range_gen(0, 100).to_chunks(4096, [&](gen::span<int> chunk) {
+    rows += chunk.size();
+    return ++calls < 5;
+  });
+  assert(rows == 5 * 4096);
+
+  size_t total = gen::make_stepper_gen(1, 10000).to_chunks(4096, [](gen::span<int>) { });
+  assert(total == 10000);
+
+  // a finite source of unknown length ends with a partial chunk
+  auto tengen = gen::make_gen_from([i = 0]() mutable {
+    if (i == 10)
+      throw std::out_of_range("done");
+    return i++;
+  });
+  std::vector<size_t> sizes;
+  tengen.to_chunks(4, [&sizes](gen::span<int> chunk) { sizes.push_back(chunk.size()); });
+  assert((sizes == std::vector<size_t> { 4, 4, 2 }));
+
+  // out_of_range from the callback is not the end of the stream
+  bool propagated = false;
+  try {
+    gen::make_stepper_gen().to_chunks(8, [](gen::span<int> chunk) {
+      std::vector<int>(chunk.begin(), chunk.end()).at(8);
+    });
+  }
+  catch (std::out_of_range &) {
+    propagated = true;
+  }
+  assert(propagated);
+
+  // bool sources, which std::vector<bool> could not buffer as a span
+  auto bits = gen::make_inorder_gen({ true, false, false, true, true }).chunk(2);
+  auto pair = bits.generate();
+  assert(pair.size() == 2 && pair[0] && !pair[1]);
+
+  auto bit_windows = gen::make_inorder_gen({ true, false, true, true }).window(2);
+  bit_windows.generate();
+  std::string state = bit_windows.snapshot();
+  auto w = bit_windows.generate();
+  assert(!w[0] && w[1]);
+  auto resumed_windows = gen::make_inorder_gen({ true, false, true, true }).window(2);
+  resumed_windows.restore(state);
+  auto rw = resumed_windows.generate();
+  assert(!rw[0] && rw[1]);
+
+  size_t set = 0;
+  size_t flags = gen::GenFactory<bool>::make().take(1000).to_chunks(64, [&set](gen::span<bool> chunk) {
+    set += static_cast<size_t>(std::count(chunk.begin(), chunk.end(), true));
+  });
+  assert(flags == 1000 && set > 0 && set < 1000);
+}
+
+void test_sorted_gen()
+{
+  auto sorted = gen::make_sorted_gen(0.0, 1.0, 100000);
+  assert(sorted.size_hint().is_exact() && sorted.size_hint().upper == 100000);
+  auto values = sorted.to_vector();
+  assert(values.size() == 100000);
+  assert(std::is_sorted(values.begin(), values.end()));
+  assert(values.front() >= 0.0 && values.back() < 1.0);
+  assert(std::abs(values[50000] - 0.5) < 0.01);
+
+  auto keys = gen::make_sorted_gen<int64_t>(-1000, 1000, 5000).to_vector();
+  assert(keys.size() == 5000 && std::is_sorted(keys.begin(), keys.end()));
+  assert(keys.front() >= -1000 && keys.back() < 1000);
+
+  std::vector<int> all;
+  for (unsigned shard = 0; shard < 4; ++shard)
+  {
+    auto part = gen::make_sorted_gen(0, 1 << 20, 20000, shard, 4, 99).to_vector();
+    const int first = static_cast<int>(shard) << 18;
+    for (int key : part)
+      assert(key >= first && key < first + (1 << 18));
+    all.insert(all.end(), part.begin(), part.end());
+  }
+  assert(all.size() == 20000 && std::is_sorted(all.begin(), all.end()));
+
+  // ranges wider than the type itself can hold
+  const int imin = std::numeric_limits<int>::min(), imax = std::numeric_limits<int>::max();
+  auto wide = gen::make_sorted_gen<int>(imin + 1, imax, 1000).to_vector();
+  assert(wide.size() == 1000 && std::is_sorted(wide.begin(), wide.end()));
+  assert(wide.front() < 0 && wide.back() > 0);
+
+  const int64_t lmin = std::numeric_limits<int64_t>::min();
+  const int64_t lmax = std::numeric_limits<int64_t>::max();
+  std::vector<int64_t> longs;
+  for (unsigned shard = 0; shard < 3; ++shard)
+  {
+    auto part = gen::make_sorted_gen<int64_t>(lmin, lmax, 999, shard, 3).to_vector();
+    longs.insert(longs.end(), part.begin(), part.end());
+  }
+  assert(longs.size() == 999 && std::is_sorted(longs.begin(), longs.end()));
+
+  const double dmax = std::numeric_limits<double>::max();
+  auto reals = gen::make_sorted_gen(-dmax, dmax, 1000).to_vector();
+  assert(std::is_sorted(reals.begin(), reals.end()));
+  for (double r : reals)
+    assert(std::isfinite(r));
+}
+
+#ifdef GEN_HAS_RANGES
+
+void test_ranges()
+{
+  auto squares = gen::make_stepper_gen(1)
+               | std::views::transform([](int i) { return i * i; })
+               | std::views::take(5);
+  std::vector<int> v;
+  for (int sq : squares)
+    v.push_back(sq);
+  assert((v == std::vector<int> { 1, 4, 9, 16, 25 }));
+
+  auto strgen = gen::make_seq_gen<std::vector>(gen::make_string_gen(gen::make_alpha_gen()), 5).take(10);
+  static_assert(std::ranges::input_range<decltype(strgen)>, "");
+  size_t count = 0;
+  for (auto && strs : strgen)
+  {
+    std::vector<std::string> owned = std::move(strs);
+    assert(!owned.empty());
+    ++count;
+  }
+  assert(count == 10);
+}
+
+#endif // GEN_HAS_RANGES
+
 #if _MSC_VER == 1900
 
 std::experimental::generator<char> hello_world()
@@ -431,6 +1558,33 @@ int main(void)
     triangle();
     test_gen_iterator();
     test_priority_n();
+    test_sinks();
+    test_columns();
+    test_snapshot();
+    test_check();
+    test_constexpr_gen();
+    test_generate_into();
+    test_charset_gen();
+    test_real_gen();
+    test_parallel_reduce();
+    test_size_hint();
+    test_vocab_gen();
+    test_graph_gen();
+    test_timeseries_gen();
+    test_markov_text_gen();
+    test_pattern_gen();
+    test_schema_gen();
+    test_random_schema();
+    test_byte_entropy();
+    test_recursive_gen();
+    test_frequency_gen();
+    test_pooled_factories();
+    test_borrow_share();
+    test_chunk_window();
+    test_sorted_gen();
+#ifdef GEN_HAS_RANGES
+    test_ranges();
+#endif // GEN_HAS_RANGES
 
 #if _MSC_VER == 1900
     //test_read_file("README.md");